@@ -2,3 +2,51 @@
 
 Import("env")
 env.Append(LINKFLAGS=["-g"])
+
+# per-symbol RAM report after each link: every .data/.bss/.noinit symbol,
+# largest first, with section totals against the 2 KB of SRAM. Written to
+# ram_report.txt in the build directory; the top entries are also printed.
+# Local statics show up as "function()::name".
+
+import re
+import subprocess
+
+RAM_SIZE = 2048
+RAM_SECTIONS = (".data", ".bss", ".noinit")
+RAM_REPORT_TOP = 25
+
+# objdump -t line: address, flags, section, size, name
+SYMBOL_RE = re.compile(r"^([0-9a-f]+) (.{7}) (\S+)\s+([0-9a-f]+) (.+)$")
+
+def ram_report(source, target, env):
+    elf = str(source[0])
+    objdump = env.subst("$CC").replace("gcc", "objdump")
+    out = subprocess.check_output([objdump, "-t", "-C", elf], env=env["ENV"], universal_newlines=True)
+
+    symbols = []
+    for line in out.splitlines():
+        m = SYMBOL_RE.match(line)
+        if not m or m.group(3) not in RAM_SECTIONS:
+            continue
+        size = int(m.group(4), 16)
+        if size:
+            symbols.append((size, m.group(3), m.group(5).strip()))
+    symbols.sort(reverse=True)
+
+    totals = dict((s, 0) for s in RAM_SECTIONS)
+    for size, section, _ in symbols:
+        totals[section] += size
+    total = sum(totals.values())
+
+    lines = ["%6d  %-7s %s" % s for s in symbols]
+    summary = "RAM: " + ", ".join("%s %d" % (s, totals[s]) for s in RAM_SECTIONS) + \
+        "; static %d of %d, %d left for heap and stack" % (total, RAM_SIZE, RAM_SIZE - total)
+    with open(env.subst("$BUILD_DIR/ram_report.txt"), "w") as f:
+        f.write("\n".join(lines + [summary]) + "\n")
+
+    print("\n".join(lines[:RAM_REPORT_TOP]))
+    if len(lines) > RAM_REPORT_TOP:
+        print("... %d more in %s" % (len(lines) - RAM_REPORT_TOP, env.subst("$BUILD_DIR/ram_report.txt")))
+    print(summary)
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", ram_report)
@@ -0,0 +1,61 @@
+#ifndef BUILTIN_PROGRAMS_H__
+#define BUILTIN_PROGRAMS_H__
+
+#include <avr/pgmspace.h>
+#include "program_builder.h"
+
+// programs in flash; also simulated by tools/sweep
+
+PROG_BUILD(PROG1,
+
+	prog_set_air_temp(117),
+	prog_wait_air_temp(117),
+
+//	prog_set_tone_repeat(0b11100011100011100011100000000),
+//	prog_wait_button(),
+//	prog_set_tone_repeat(0),
+
+	prog_set_air_temp(160),
+	prog_wait_air_temp(160),
+	prog_dwell(60*5),
+
+	prog_set_air_temp(73),
+	prog_dwell(60*60*1),
+	prog_set_air_temp(151),
+	prog_wait_air_temp(151),
+	prog_dwell(60*60*0.9),
+	prog_set_air_temp(74),
+	prog_dwell(60*60*1),
+
+	prog_set_air_temp(152),
+	prog_wait_air_temp(152),
+	prog_dwell(60*60*0.7),
+	prog_set_air_temp(75),
+	prog_dwell(60*60*1),
+
+	prog_set_tone_repeat(0b1111111111111000000000000000),
+	prog_dwell(5),
+	prog_set_tone_repeat(0),
+	prog_end());
+
+PROG_BUILD(PROG2,
+	prog_set_air_temp(73),
+	prog_dwell(60*60*2),
+	prog_set_air_temp(151),
+	prog_wait_air_temp(151),
+	prog_dwell(60*60*0.9),
+	prog_set_air_temp(74),
+	prog_dwell(60*60*2),
+
+	prog_set_air_temp(152),
+	prog_wait_air_temp(152),
+	prog_dwell(60*60*0.8),
+	prog_set_air_temp(75),
+	prog_dwell(60*60*2),
+
+	prog_set_tone_repeat(0b1111111111111000000000000000),
+	prog_dwell(5),
+	prog_set_tone_repeat(0),
+	prog_end());
+
+#endif
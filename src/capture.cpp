@@ -0,0 +1,155 @@
+#include <Arduino.h>
+#include <string.h>
+#include "capture.h"
+
+#if CAPTURE_SAMPLES
+
+static capture_sample_t samples[CAPTURE_SAMPLES];
+static uint8_t head; // next sample to write
+static uint8_t count; // valid samples
+static uint8_t since; // samples recorded at or after the trigger
+static uint8_t post; // samples to record after the trigger
+static uint8_t mask; // armed triggers
+static uint8_t div_count;
+static capture_state_t state;
+static uint8_t reason;
+static uint8_t divider = 1;
+
+// capture_print() cursor
+#define CAPTURE_PRINT_ROW_MAX 32 // longest CSV row
+static bool printing;
+static uint8_t print_n; // index of the next sample
+static uint8_t print_trigger_index;
+
+void capture_arm(uint8_t mask_, uint8_t pre_trigger, uint8_t divider_)
+{
+	head = count = since = 0;
+	mask = mask_;
+	post = CAPTURE_SAMPLES - (pre_trigger < CAPTURE_SAMPLES ? pre_trigger : CAPTURE_SAMPLES - 1);
+	div_count = 0;
+	state = CAPTURE_ARMED;
+	reason = 0;
+	divider = divider_ ? divider_ : 1;
+	printing = false;
+}
+
+void capture_add(const uint16_t *adc, uint8_t power, bool heater_on)
+{
+	if(state != CAPTURE_ARMED && state != CAPTURE_TRIGGERED) return;
+	if(++div_count < divider) return;
+	div_count = 0;
+
+	capture_sample_t &s = samples[head];
+	uint8_t hi = heater_on ? 0x80 : 0;
+	for(uint8_t i = 0; i < CAPTURE_CHANNELS; ++i)
+	{
+		s.adc_lo[i] = adc[i] & 0xff;
+		hi |= ((adc[i] >> 8) & 3) << (i * 2);
+	}
+	s.adc_hi = hi;
+	s.power = power;
+
+	head = (head + 1) % CAPTURE_SAMPLES;
+	if(count < CAPTURE_SAMPLES) ++count;
+
+	// the post-trigger samples overwrite history older than pre_trigger
+	if(state == CAPTURE_TRIGGERED && ++since == post)
+		state = CAPTURE_DONE;
+}
+
+void capture_trigger(uint8_t reason_)
+{
+	if(state != CAPTURE_ARMED || !(mask & reason_)) return;
+	reason = reason_;
+	state = CAPTURE_TRIGGERED;
+}
+
+void capture_freeze(uint8_t reason_)
+{
+	if(state == CAPTURE_ARMED) reason = reason_;
+	else if(state != CAPTURE_TRIGGERED) return;
+	state = CAPTURE_DONE;
+}
+
+static void fill_header(capture_header_t &h)
+{
+	h.state = state;
+	h.reason = reason;
+	h.divider = divider;
+	h.capacity = CAPTURE_SAMPLES;
+	h.count = count;
+	h.trigger_index = count - since;
+}
+
+static const capture_sample_t &sample(uint8_t i)
+{
+	return samples[(head + CAPTURE_SAMPLES - count + i) % CAPTURE_SAMPLES];
+}
+
+uint16_t capture_dump_length()
+{
+	return sizeof(capture_header_t) + count * sizeof(capture_sample_t);
+}
+
+uint8_t capture_dump(uint16_t offset, uint8_t *buf, uint8_t len)
+{
+	capture_header_t h;
+	fill_header(h);
+
+	uint8_t n = 0;
+	for(; n < len && offset < capture_dump_length(); ++n, ++offset)
+	{
+		if(offset < sizeof(h))
+		{
+			buf[n] = ((const uint8_t *)&h)[offset];
+		}
+		else
+		{
+			uint16_t o = offset - sizeof(h);
+			buf[n] = ((const uint8_t *)&sample(o / sizeof(capture_sample_t)))[o % sizeof(capture_sample_t)];
+		}
+	}
+	return n;
+}
+
+void capture_print()
+{
+	capture_header_t h;
+	fill_header(h);
+	Serial.print(F("capture: state "));
+	Serial.print((int)h.state);
+	Serial.print(F(" reason "));
+	Serial.print((int)h.reason);
+	Serial.print(F("\r\nms,adc0,adc1,adc2,power,pin\r\n"));
+	if(state == CAPTURE_ARMED || state == CAPTURE_TRIGGERED) state = CAPTURE_DONE;
+	printing = true;
+	print_n = 0;
+	print_trigger_index = h.trigger_index;
+}
+
+bool capture_print_poll()
+{
+	if(!printing || Serial.availableForWrite() < CAPTURE_PRINT_ROW_MAX) return false;
+	if(print_n >= count)
+	{
+		printing = false;
+		return true;
+	}
+
+	const capture_sample_t &s = sample(print_n);
+	Serial.print(((int)print_n - print_trigger_index) * divider); // relative to the trigger
+	for(uint8_t c = 0; c < CAPTURE_CHANNELS; ++c)
+	{
+		Serial.print(',');
+		Serial.print(s.adc_lo[c] | ((s.adc_hi >> (c * 2)) & 3) << 8);
+	}
+	Serial.print(',');
+	Serial.print((int)s.power);
+	Serial.print(',');
+	Serial.print((s.adc_hi & 0x80) ? 1 : 0);
+	Serial.print(F("\r\n"));
+	++print_n;
+	return false;
+}
+
+#endif
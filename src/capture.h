@@ -0,0 +1,143 @@
+#ifndef CAPTURE_H__
+#define CAPTURE_H__
+
+#include <stdint.h>
+
+/*
+	Triggered high-rate capture for control loop debugging.
+
+	Works like a single-shot oscilloscope on the 1 ms sampling of
+	manage_temp(): every divider-th millisecond the raw ADC readings of all
+	sensors, heater_power and the level of the heater pin are written to a
+	RAM ring. While armed the ring keeps rolling; the first trigger whose bit
+	is in the armed mask keeps pre_trigger samples of history, records the
+	rest of the buffer after it and freezes the capture until it is read and
+	re-armed.
+
+	The buffer takes CAPTURE_SAMPLES * sizeof(capture_sample_t) bytes of RAM,
+	so it is only built in with -DCAPTURE_SAMPLES=n (see the
+	miniatmega328_capture env). With the default of 0 every function is an
+	empty inline and the capture is always empty; callers whose arguments
+	cost time, like the 1 ms capture_add(), are compiled out with
+	#if CAPTURE_SAMPLES.
+
+	The dump stream of CMD_GET_CAPTURE is capture_header_t followed by
+	count capture_sample_t from the oldest to the newest.
+*/
+
+#ifndef CAPTURE_SAMPLES
+#define CAPTURE_SAMPLES 0
+#endif
+
+#define CAPTURE_CHANNELS 3 // ADC channels per sample
+
+// trigger sources; bits of the armed mask
+enum capture_trigger_t : uint8_t
+{
+	CAPTURE_TRIG_MANUAL = 0x01, //!< capture_trigger() from serial
+	CAPTURE_TRIG_SET_POINT = 0x02, //!< heater or air set point changed
+	CAPTURE_TRIG_RANGE = 0x04, //!< the followed PID entered or left its effective range
+	CAPTURE_TRIG_SUPPRESS = 0x08, //!< heating suppressed by an over-temperature
+	CAPTURE_TRIG_PANIC = 0x10, //!< panic(); the capture ends at the panic
+
+	CAPTURE_TRIG_ALL = 0x1f
+};
+
+enum capture_state_t : uint8_t
+{
+	CAPTURE_IDLE, //!< not recording
+	CAPTURE_ARMED, //!< recording pre-trigger history
+	CAPTURE_TRIGGERED, //!< recording post-trigger samples
+	CAPTURE_DONE, //!< frozen until re-armed
+};
+
+/**
+ * one sample: 10-bit ADC readings packed into 5 bytes
+ * */
+struct __attribute__((packed)) capture_sample_t
+{
+	uint8_t adc_lo[CAPTURE_CHANNELS]; //!< low 8 bits of each reading
+	uint8_t adc_hi; //!< bits 1:0, 3:2 and 5:4 are the high bits of channel 0, 1 and 2; bit 7 is the heater pin
+	uint8_t power; //!< heater_power, saturated to 255
+};
+
+/**
+ * header of the dump stream
+ * */
+struct __attribute__((packed)) capture_header_t
+{
+	uint8_t state; //!< capture_state_t
+	uint8_t reason; //!< capture_trigger_t that fired, or 0
+	uint8_t divider; //!< ms per sample
+	uint8_t capacity; //!< CAPTURE_SAMPLES
+	uint8_t count; //!< samples in the dump
+	uint8_t trigger_index; //!< index of the first sample at or after the trigger
+};
+
+#if CAPTURE_SAMPLES
+
+static_assert(CAPTURE_SAMPLES <= 255, "sample counts are 8-bit");
+
+/**
+ * Clear the buffer and start recording. Triggers not in mask are ignored.
+ * */
+void capture_arm(uint8_t mask, uint8_t pre_trigger, uint8_t divider);
+
+/**
+ * Feed one millisecond of readings; called from manage_temp()
+ * */
+void capture_add(const uint16_t *adc, uint8_t power, bool heater_on);
+
+/**
+ * Report a trigger condition; ignored unless armed for it
+ * */
+void capture_trigger(uint8_t reason);
+
+/**
+ * Stop recording at once, e.g. on panic; the trigger is the newest sample
+ * */
+void capture_freeze(uint8_t reason);
+
+/**
+ * Length of the dump stream
+ * */
+uint16_t capture_dump_length();
+
+/**
+ * Copy up to len bytes of the dump stream from offset. Returns the number of bytes copied.
+ * */
+uint8_t capture_dump(uint16_t offset, uint8_t *buf, uint8_t len);
+
+/**
+ * Start printing the capture to serial as CSV, oldest first. Recording
+ * stops so the rows stay put; capture_arm() starts over and abandons the
+ * print. The rows are written by capture_print_poll().
+ * */
+void capture_print();
+
+/**
+ * Continue a capture_print(); call from the main loop. Writes the next row
+ * if the serial transmit buffer has room for it. Returns true once, when the
+ * last row has been written.
+ * */
+bool capture_print_poll();
+
+#else
+
+static inline void capture_arm(uint8_t, uint8_t, uint8_t) {}
+static inline void capture_add(const uint16_t *, uint8_t, bool) {}
+static inline void capture_trigger(uint8_t) {}
+static inline void capture_freeze(uint8_t) {}
+static inline uint16_t capture_dump_length() { return sizeof(capture_header_t); }
+static inline uint8_t capture_dump(uint16_t offset, uint8_t *buf, uint8_t len)
+{
+	uint8_t n = 0;
+	for(; n < len && offset < sizeof(capture_header_t); ++n, ++offset) buf[n] = 0; // idle and empty
+	return n;
+}
+static inline void capture_print() {}
+static inline bool capture_print_poll() { return false; }
+
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <string.h>
+#include "checkpoint.h"
+#include "eeprom_layout.h"
+
+/*
+	Checkpoints are written to a ring of EEPROM slots, one slot per write, to
+	spread the wear. Each record carries a sequence number; the latest record is
+	the one whose successor does not carry the next sequence number. A record
+	torn by a power loss fails its CRC and the previous record is used instead.
+*/
+
+struct checkpoint_record_t
+{
+	checkpoint_t cp;
+	uint8_t seq; //!< sequence number; increments by one per write
+	uint8_t crc; //!< crc8 over cp and seq
+};
+static_assert(sizeof(checkpoint_record_t) <= EEPROM_CHECKPOINT_SLOT_SIZE, "checkpoint record too large");
+
+static int8_t last_slot = -1; //!< slot of the latest record, -1 if not yet scanned
+static uint8_t last_seq;
+static checkpoint_t last_cp;
+static uint32_t last_write_ms;
+
+static uint8_t *slot_addr(uint8_t slot)
+{
+	return (uint8_t *)(uintptr_t)(EEPROM_CHECKPOINT_ADDR + slot * EEPROM_CHECKPOINT_SLOT_SIZE);
+}
+
+static uint8_t record_crc(const checkpoint_record_t &rec)
+{
+	const uint8_t *p = (const uint8_t *)&rec;
+	uint8_t crc = 0;
+	for(uint8_t i = 0; i < offsetof(checkpoint_record_t, crc); ++i)
+		crc = _crc8_ccitt_update(crc, p[i]);
+	return crc;
+}
+
+static bool read_record(uint8_t slot, checkpoint_record_t &rec)
+{
+	eeprom_read_block(&rec, slot_addr(slot), sizeof(rec));
+	return rec.crc == record_crc(rec);
+}
+
+// find the latest slot
+static void scan_slots()
+{
+	if(last_slot >= 0) return;
+
+	uint8_t prev_seq = eeprom_read_byte(slot_addr(0) + offsetof(checkpoint_record_t, seq));
+	last_slot = EEPROM_CHECKPOINT_SLOTS - 1;
+	for(uint8_t i = 1; i < EEPROM_CHECKPOINT_SLOTS; ++i)
+	{
+		uint8_t seq = eeprom_read_byte(slot_addr(i) + offsetof(checkpoint_record_t, seq));
+		if(seq != (uint8_t)(prev_seq + 1))
+		{
+			last_slot = i - 1;
+			break;
+		}
+		prev_seq = seq;
+	}
+
+	checkpoint_record_t rec;
+	if(!read_record(last_slot, rec)) rec.cp.prog = CHECKPOINT_NO_PROGRAM;
+	last_seq = rec.seq;
+	last_cp = rec.cp;
+	last_write_ms = millis();
+}
+
+bool checkpoint_load(checkpoint_t &cp)
+{
+	scan_slots();
+
+	checkpoint_record_t rec;
+	if(!read_record(last_slot, rec))
+	{
+		// the latest write may be torn; fall back to the previous one
+		if(!read_record(last_slot == 0 ? EEPROM_CHECKPOINT_SLOTS - 1 : last_slot - 1, rec))
+			return false;
+	}
+
+	cp = rec.cp;
+	return cp.prog != CHECKPOINT_NO_PROGRAM;
+}
+
+void checkpoint_save(const checkpoint_t &cp, bool force)
+{
+	scan_slots();
+
+	if(!memcmp(&cp, &last_cp, sizeof(cp))) return; // nothing changed
+	uint32_t now = millis();
+	if(!force && (int32_t)(now - last_write_ms) < CHECKPOINT_INTERVAL_MS) return;
+
+	checkpoint_record_t rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.cp = cp;
+	rec.seq = last_seq + 1;
+	rec.crc = record_crc(rec);
+
+	if(++last_slot >= EEPROM_CHECKPOINT_SLOTS) last_slot = 0;
+	eeprom_update_block(&rec, slot_addr(last_slot), sizeof(rec));
+
+	last_seq = rec.seq;
+	last_cp = cp;
+	last_write_ms = now;
+}
+
+void checkpoint_clear()
+{
+	checkpoint_t cp;
+	memset(&cp, 0, sizeof(cp));
+	cp.prog = CHECKPOINT_NO_PROGRAM;
+	checkpoint_save(cp, true);
+}
@@ -0,0 +1,39 @@
+#ifndef CHECKPOINT_H__
+#define CHECKPOINT_H__
+
+#include <stdint.h>
+
+#define CHECKPOINT_NO_PROGRAM 0xff
+#define CHECKPOINT_INTERVAL_MS 60000 // minimum interval between non-forced checkpoint writes
+
+/**
+ * program runner state which is saved to EEPROM to survive power loss
+ * */
+struct checkpoint_t
+{
+	uint8_t prog; //!< program index, or CHECKPOINT_NO_PROGRAM
+	uint16_t ip; //!< index of the instruction being executed
+	int32_t secs_remain; //!< remaining dwell seconds of the instruction
+	int16_t heater_set_point; //!< heater set point at the time of the checkpoint
+	int16_t air_set_point; //!< air set point at the time of the checkpoint
+};
+
+/**
+ * Load the latest valid checkpoint.
+ * Returns false if there is none or no program was running.
+ * */
+bool checkpoint_load(checkpoint_t &cp);
+
+/**
+ * Save a checkpoint. Unless `force` is true, the write is skipped if the
+ * last write is younger than CHECKPOINT_INTERVAL_MS. Unchanged state is never
+ * written.
+ * */
+void checkpoint_save(const checkpoint_t &cp, bool force);
+
+/**
+ * Mark that no program is running
+ * */
+void checkpoint_clear();
+
+#endif
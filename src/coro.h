@@ -0,0 +1,95 @@
+#ifndef CORO_H__
+#define CORO_H__
+
+#include <Arduino.h>
+#include <stdint.h>
+
+/*
+	Stackless coroutines.
+
+	A coroutine is an object derived from coro_t whose run() body is enclosed
+	in CORO_BEGIN / CORO_END. run() executes until the next CORO_YIELD or
+	unsatisfied CORO_AWAIT* and returns; the next call continues from there.
+	Variables which must survive a yield are members of the object, so every
+	instance carries its own state and any number of instances may run at
+	once. Nothing is allocated; a suspended coroutine is only its resume point
+	and its members. As with any switch-based continuation, locals with
+	initializers must not live across a yield.
+*/
+
+#define CORO_DONE UINT16_MAX
+
+class coro_t
+{
+protected:
+	uint16_t coro_line; //!< resume point; 0 = beginning, CORO_DONE = finished
+
+public:
+	coro_t() : coro_line(0) {}
+
+	/**
+	 * run until the next suspension point
+	 * */
+	virtual void run() = 0;
+
+	/**
+	 * whether the coroutine has run to its end or has been cancelled
+	 * */
+	bool done() const { return coro_line == CORO_DONE; }
+
+	/**
+	 * start over from the beginning at the next run()
+	 * */
+	void restart() { coro_line = 0; }
+
+	/**
+	 * abandon the coroutine; run() does nothing until restart()
+	 * */
+	void cancel() { coro_line = CORO_DONE; }
+};
+
+#define CORO_BEGIN switch(coro_line) { case 0:
+#define CORO_END default:; } coro_line = CORO_DONE
+
+#define CORO_YIELD2(COUNTER) \
+	do { \
+	coro_line = (COUNTER) + 1; \
+	return; \
+	case (COUNTER) + 1:; \
+	} while(0)
+
+#define CORO_YIELD CORO_YIELD2(__COUNTER__)
+
+// suspend until COND becomes true; COND is evaluated at every run()
+#define CORO_AWAIT2(COND, COUNTER) \
+	do { \
+	coro_line = (COUNTER) + 1; \
+	case (COUNTER) + 1: \
+	if(!(COND)) return; \
+	} while(0)
+
+#define CORO_AWAIT(COND) CORO_AWAIT2(COND, __COUNTER__)
+
+// suspend until millis() reaches MS (a member holding an absolute time)
+#define CORO_AWAIT_UNTIL_MS(MS) CORO_AWAIT((int32_t)(millis() - (MS)) >= 0)
+
+/**
+ * Round-robin executor; each run() steps every unfinished coroutine once
+ * */
+template <uint8_t N>
+class coro_executor_t
+{
+	coro_t * const tasks[N];
+
+public:
+	template <typename... T>
+	coro_executor_t(T *... t) : tasks{t...} {}
+
+	void run()
+	{
+		for(coro_t *t : tasks)
+			if(!t->done()) t->run();
+	}
+};
+
+#endif
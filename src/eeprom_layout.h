@@ -0,0 +1,43 @@
+#ifndef EEPROM_LAYOUT_H__
+#define EEPROM_LAYOUT_H__
+
+#include <avr/io.h>
+#include "prog_store.h"
+#include "ff_table.h"
+
+// EEPROM address map (ATmega328: 1024 bytes)
+
+// program checkpoint ring; see checkpoint.cpp
+#define EEPROM_CHECKPOINT_ADDR 0
+#define EEPROM_CHECKPOINT_SLOTS 12
+#define EEPROM_CHECKPOINT_SLOT_SIZE 16
+#define EEPROM_CHECKPOINT_END (EEPROM_CHECKPOINT_ADDR + EEPROM_CHECKPOINT_SLOTS * EEPROM_CHECKPOINT_SLOT_SIZE)
+
+// user programs; see prog_store.cpp
+#define EEPROM_PROG_STORE_ADDR EEPROM_CHECKPOINT_END
+#define EEPROM_PROG_STORE_SLOT_SIZE 112
+#define EEPROM_PROG_STORE_END (EEPROM_PROG_STORE_ADDR + PROG_STORE_SLOTS * EEPROM_PROG_STORE_SLOT_SIZE)
+
+// tunable parameters; see params.cpp
+#define EEPROM_PARAMS_ADDR EEPROM_PROG_STORE_END
+#define EEPROM_PARAMS_SIZE 128
+#define EEPROM_PARAMS_END (EEPROM_PARAMS_ADDR + EEPROM_PARAMS_SIZE)
+
+// watchdog post-mortem; see watchdog.cpp
+#define EEPROM_WATCHDOG_ADDR EEPROM_PARAMS_END
+#define EEPROM_WATCHDOG_SIZE 4
+#define EEPROM_WATCHDOG_END (EEPROM_WATCHDOG_ADDR + EEPROM_WATCHDOG_SIZE)
+
+// learned feed-forward tables; see ff_table.cpp
+#define EEPROM_HEATER_FF_ADDR EEPROM_WATCHDOG_END
+#define EEPROM_AIR_FF_ADDR (EEPROM_HEATER_FF_ADDR + FF_EEPROM_SIZE)
+#define EEPROM_FF_END (EEPROM_AIR_FF_ADDR + FF_EEPROM_SIZE)
+
+// temperature history; see history.cpp
+#define EEPROM_HISTORY_ADDR EEPROM_FF_END
+#define EEPROM_HISTORY_SIZE 176
+#define EEPROM_HISTORY_END (EEPROM_HISTORY_ADDR + EEPROM_HISTORY_SIZE)
+
+static_assert(EEPROM_HISTORY_END <= E2END + 1, "EEPROM layout overflows");
+
+#endif
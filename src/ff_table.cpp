@@ -0,0 +1,109 @@
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <math.h>
+#include <string.h>
+#include "ff_table.h"
+
+/*
+	EEPROM record: bins[FF_BINS] crc8.
+*/
+
+static uint8_t bins_crc(const uint8_t *bins)
+{
+	uint8_t crc = 0;
+	for(uint8_t i = 0; i < FF_BINS; ++i)
+		crc = _crc8_ccitt_update(crc, bins[i]);
+	return crc;
+}
+
+void ff_table_t::clear()
+{
+	bins[0] = 0;
+	for(uint8_t i = 1; i < FF_BINS; ++i)
+		bins[i] = FF_UNKNOWN;
+	settle_set_point = 0;
+	settle_power = 0;
+	settle_blocks = 0;
+}
+
+bool ff_table_t::load()
+{
+	uint8_t buf[FF_BINS];
+	eeprom_read_block(buf, (const void *)(uintptr_t)eeprom_addr, FF_BINS);
+	if(buf[0] != 0 || bins_crc(buf) != eeprom_read_byte((const uint8_t *)(uintptr_t)(eeprom_addr + FF_BINS)))
+	{
+		clear();
+		return false;
+	}
+	memcpy(bins, buf, FF_BINS);
+	return true;
+}
+
+void ff_table_t::save()
+{
+	eeprom_update_block(bins, (void *)(uintptr_t)eeprom_addr, FF_BINS);
+	eeprom_update_byte((uint8_t *)(uintptr_t)(eeprom_addr + FF_BINS), bins_crc(bins));
+}
+
+void ff_table_t::erase()
+{
+	clear();
+	eeprom_update_byte((uint8_t *)(uintptr_t)eeprom_addr, FF_UNKNOWN);
+}
+
+float ff_table_t::lookup(float set_point, float env) const
+{
+	float rise = set_point - env;
+	if(rise <= 0) return 0;
+
+	float pos = rise * (1.0f / FF_BIN_WIDTH);
+	uint8_t lo = pos >= FF_BINS - 1 ? FF_BINS - 1 : (uint8_t)pos;
+	while(bins[lo] == FF_UNKNOWN) --lo; // bin 0 is always known
+	uint8_t hi = (uint8_t)pos + 1;
+	while(hi < FF_BINS && bins[hi] == FF_UNKNOWN) ++hi;
+
+	if(hi < FF_BINS)
+	{
+		// interpolate
+		float t = (pos - lo) / (hi - lo);
+		return bins[lo] + (bins[hi] - bins[lo]) * t;
+	}
+	if(lo == 0) return 0;
+
+	// proportional past the last learned bin
+	return bins[lo] * pos / lo;
+}
+
+bool ff_table_t::learn(float set_point, float temp, float env, float power)
+{
+	if(set_point != settle_set_point || fabsf(temp - set_point) > FF_SETTLE_BAND)
+	{
+		settle_set_point = set_point;
+		settle_power = 0;
+		settle_blocks = 0;
+		return false;
+	}
+
+	settle_power += power;
+	if(++settle_blocks < FF_SETTLE_BLOCKS) return false;
+
+	float mean = settle_power * (1.0f / FF_SETTLE_BLOCKS);
+	settle_power = 0;
+	settle_blocks = 0;
+
+	float pos = (temp - env) * (1.0f / FF_BIN_WIDTH);
+	uint8_t bin = (uint8_t)(pos + 0.5f);
+	if(pos <= 0 || bin == 0 || bin >= FF_BINS) return false;
+
+	// scale to the rise of the bin and average with what was learned before
+	float v = mean * bin / pos;
+	if(bins[bin] != FF_UNKNOWN) v = (v + bins[bin]) * 0.5f;
+	uint8_t nv = v >= FF_UNKNOWN - 1 ? FF_UNKNOWN - 1 : (uint8_t)(v + 0.5f);
+
+	uint8_t old = bins[bin];
+	bins[bin] = nv;
+	if(old == FF_UNKNOWN || abs((int)nv - (int)old) >= FF_SAVE_THRESHOLD)
+		save();
+	return true;
+}
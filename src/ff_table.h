@@ -0,0 +1,68 @@
+#ifndef FF_TABLE_H__
+#define FF_TABLE_H__
+
+#include <stdint.h>
+
+/*
+	Learned steady-state heater power versus temperature, for the feed-forward
+	input of pid_controller_t.
+
+	The table is indexed by the rise of the set point above the environment
+	temperature in FF_BIN_WIDTH steps. Whenever a hold stays within
+	FF_SETTLE_BAND of its set point for FF_SETTLE_BLOCKS blocks, the mean heater
+	power over that time is folded into the nearest bin and the table is saved
+	to EEPROM. Bins are scaled to their own rise on the way in, as the loss of
+	an oven is roughly proportional to its rise. Lookups interpolate between
+	learned bins and extrapolate proportionally past the last one, so a hold
+	gets a usable estimate after a single neighbouring hold has converged.
+*/
+
+#define FF_BIN_WIDTH 20 // deg C of rise per bin
+#define FF_BINS 21 // bin 0 is always zero power
+#define FF_UNKNOWN 0xff // bin not learned yet
+#define FF_SETTLE_BAND 1.0f // deg C
+#define FF_SETTLE_BLOCKS 600 // oversample blocks; about 2.5 minutes
+#define FF_SAVE_THRESHOLD 2 // minimum change of a bin which is written to EEPROM
+#define FF_EEPROM_SIZE (FF_BINS + 1) // bins and crc8
+
+class ff_table_t
+{
+	uint16_t eeprom_addr;
+	uint8_t bins[FF_BINS]; //!< learned power per bin, 0 to 254, or FF_UNKNOWN
+	float settle_set_point; //!< set point of the hold being observed
+	float settle_power; //!< sum of power over the hold
+	uint16_t settle_blocks; //!< blocks the hold has stayed settled
+
+	void save();
+
+public:
+	ff_table_t(uint16_t addr) : eeprom_addr(addr) { clear(); }
+
+	/**
+	 * forget everything learned; EEPROM is untouched until the next save
+	 * */
+	void clear();
+
+	/**
+	 * load the table from EEPROM. returns false, leaving the table empty, if EEPROM holds no valid table.
+	 * */
+	bool load();
+
+	/**
+	 * invalidate the table in EEPROM and forget it
+	 * */
+	void erase();
+
+	/**
+	 * steady-state power expected to hold set_point, 0 if nothing has been learned
+	 * */
+	float lookup(float set_point, float env) const;
+
+	/**
+	 * Feed one block of a hold at set_point; power is the heater power
+	 * applied during the block. Returns true if the table has been updated.
+	 * */
+	bool learn(float set_point, float temp, float env, float power);
+};
+
+#endif
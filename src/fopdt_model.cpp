@@ -0,0 +1,141 @@
+#include <avr/pgmspace.h>
+#include <math.h>
+#include "fopdt_model.h"
+
+#define SAMPLE_SECS (FOPDT_BLOCK_MS * FOPDT_SAMPLE_BLOCKS * 0.001f)
+
+// candidate dead times, samples
+static const uint8_t delays[FOPDT_NUM_DELAYS] PROGMEM = {0, 3, 7, FOPDT_MAX_DELAY};
+
+static_assert(((FOPDT_MAX_DELAY + 1) & FOPDT_MAX_DELAY) == 0, "power history length must be a power of two");
+
+void fopdt_model_t::reset()
+{
+	float a = expf(-SAMPLE_SECS / prior_tau) - 1.0f;
+	float b = -a * prior_gain;
+	for(auto &&e : est)
+	{
+		e.a = a;
+		e.b = b;
+		// prior uncertainty of the order of the values themselves
+		e.p11 = a * a;
+		e.p12 = 0;
+		e.p22 = b * b;
+		e.mse = 0;
+	}
+	for(auto &&p : power_hist) p = 0;
+	hist_pos = 0;
+	best = 0;
+	samples = 0;
+	blocks = 0;
+	power_sum = 0;
+	prev_x = 0;
+	primed = false;
+}
+
+void fopdt_model_t::update_estimator(uint8_t i, float x, float dx)
+{
+	estimator_t &e = est[i];
+	float u = power_hist[(hist_pos - pgm_read_byte(delays + i)) & FOPDT_MAX_DELAY] * (1.0f / 255);
+
+	// a priori prediction error
+	float err = dx - (e.a * x + e.b * u);
+	e.mse += (err * err - e.mse) * FOPDT_ERR_COEFF;
+
+	// gain vector g = P phi / (lambda + phi' P phi)
+	float q1 = e.p11 * x + e.p12 * u;
+	float q2 = e.p12 * x + e.p22 * u;
+	float den = FOPDT_FORGETTING + x * q1 + u * q2;
+	float g1 = q1 / den;
+	float g2 = q2 / den;
+
+	e.a += g1 * err;
+	e.b += g2 * err;
+
+	// P = (P - g q') / lambda; forgetting is suspended while the covariance
+	// is back at its prior size, so that it does not wind up without excitation
+	e.p11 -= g1 * q1;
+	e.p12 -= g1 * q2;
+	e.p22 -= g2 * q2;
+	float a0 = expf(-SAMPLE_SECS / prior_tau) - 1.0f;
+	if(e.p11 < a0 * a0 && e.p22 < a0 * a0 * prior_gain * prior_gain)
+	{
+		e.p11 *= 1.0f / FOPDT_FORGETTING;
+		e.p12 *= 1.0f / FOPDT_FORGETTING;
+		e.p22 *= 1.0f / FOPDT_FORGETTING;
+	}
+}
+
+void fopdt_model_t::update(float temp, float env, float power)
+{
+	power_sum += power;
+	if(++blocks < FOPDT_SAMPLE_BLOCKS) return;
+
+	float p = power_sum * (255.0f / FOPDT_SAMPLE_BLOCKS) + 0.5f;
+	hist_pos = (hist_pos + 1) & FOPDT_MAX_DELAY;
+	power_hist[hist_pos] = p > 255 ? 255 : (p < 0 ? 0 : (uint8_t)p);
+	blocks = 0;
+	power_sum = 0;
+
+	float x = temp - env;
+	if(primed)
+	{
+		float dx = x - prev_x;
+		for(uint8_t i = 0; i < FOPDT_NUM_DELAYS; ++i)
+			update_estimator(i, prev_x, dx);
+		for(uint8_t i = 0; i < FOPDT_NUM_DELAYS; ++i)
+			if(est[i].mse < est[best].mse) best = i;
+		if(samples < UINT8_MAX) ++samples;
+	}
+	primed = true;
+	prev_x = x;
+}
+
+bool fopdt_model_t::valid() const
+{
+	const estimator_t &e = est[best];
+	return samples >= FOPDT_MIN_SAMPLES && e.a > -1.0f && e.a < 0.0f && e.b > 0.0f;
+}
+
+float fopdt_model_t::gain() const
+{
+	return -est[best].b / est[best].a;
+}
+
+float fopdt_model_t::tau() const
+{
+	return -SAMPLE_SECS / logf(1.0f + est[best].a);
+}
+
+float fopdt_model_t::dead_time() const
+{
+	return pgm_read_byte(delays + best) * SAMPLE_SECS;
+}
+
+float fopdt_model_t::error() const
+{
+	return sqrtf(est[best].mse);
+}
+
+int32_t fopdt_model_t::predict_secs(float from, float to, float env) const
+{
+	if(!valid()) return -1;
+
+	float x0 = from - env;
+	float x1 = to - env;
+	float ratio;
+	if(x1 > x0)
+	{
+		// heating at full power towards env + gain
+		float xs = gain();
+		if(x1 >= xs) return -1;
+		ratio = (xs - x0) / (xs - x1);
+	}
+	else
+	{
+		// cooling towards env
+		if(x1 <= 0) return -1;
+		ratio = x0 / x1;
+	}
+	return (int32_t)(tau() * logf(ratio) + 0.5f);
+}
@@ -0,0 +1,91 @@
+#ifndef FOPDT_MODEL_H__
+#define FOPDT_MODEL_H__
+
+#include <stdint.h>
+
+/*
+	Online first-order-plus-dead-time model of one temperature.
+
+	With x = T - Tenv and u the heater power (0 to 1), the response is
+	modelled as
+	  dx/dt = (gain * u(t - dead_time) - x) / tau
+	Sampled every FOPDT_SAMPLE_BLOCKS oversample blocks this is the linear
+	regression
+	  x[k+1] - x[k] = a * x[k] + b * u[k-d],  a = exp(-h/tau) - 1,  b = -a * gain
+	which is identified by recursive least squares with forgetting. The dead
+	time d is not linear in the samples, so one estimator runs for each of
+	FOPDT_NUM_DELAYS candidate delays and the one with the smallest recent
+	one-step prediction error is used.
+*/
+
+#define FOPDT_BLOCK_MS 256 // update interval; one oversample block
+#define FOPDT_SAMPLE_BLOCKS 16 // blocks per model sample
+#define FOPDT_NUM_DELAYS 4
+#define FOPDT_MAX_DELAY 15 // samples; the longest candidate delay
+#define FOPDT_FORGETTING 0.995f // RLS forgetting factor per sample
+#define FOPDT_ERR_COEFF (1.0f / 32) // prediction error IIR LPF coeff
+#define FOPDT_MIN_SAMPLES 32 // samples before the model is trusted
+
+class fopdt_model_t
+{
+	/**
+	 * RLS estimator for one candidate delay
+	 * */
+	struct estimator_t
+	{
+		float a, b; //!< regression parameters
+		float p11, p12, p22; //!< covariance
+		float mse; //!< filtered squared one-step prediction error
+	};
+
+	float prior_gain; //!< initial gain, deg C above environment at full power
+	float prior_tau; //!< initial time constant, seconds
+
+	estimator_t est[FOPDT_NUM_DELAYS];
+	uint8_t power_hist[FOPDT_MAX_DELAY + 1]; //!< past sample powers, 0 to 255
+	uint8_t hist_pos; //!< index of the latest sample in power_hist
+	uint8_t best; //!< estimator with the smallest error
+	uint8_t samples; //!< samples taken, saturating
+	uint8_t blocks; //!< blocks in the current sample
+	float power_sum; //!< sum of power in the current sample
+	float prev_x; //!< temperature above environment at the last sample
+	bool primed; //!< prev_x is valid
+
+	void update_estimator(uint8_t i, float x, float dx);
+
+public:
+	fopdt_model_t(float gain, float tau) : prior_gain(gain), prior_tau(tau)
+	{
+		reset();
+	}
+
+	/**
+	 * forget everything learned and start over from the priors
+	 * */
+	void reset();
+
+	/**
+	 * Feed one block. power is the heater power applied during the block, 0 to 1.
+	 * */
+	void update(float temp, float env, float power);
+
+	/**
+	 * whether enough has been learned for the model to be used
+	 * */
+	bool valid() const;
+
+	float gain() const; //!< deg C above environment at full power
+	float tau() const; //!< time constant, seconds
+	float dead_time() const; //!< seconds
+	float error() const; //!< RMS one-step prediction error, deg C
+
+	/**
+	 * Seconds needed to go from `from` to `to` at full power, or with the
+	 * heater off if `to` is below `from`, once the power change has taken
+	 * effect; callers add dead_time() where it applies. Returns -1 if the
+	 * model is not valid or `to` is out of reach.
+	 * */
+	int32_t predict_secs(float from, float to, float env) const;
+};
+
+#endif
@@ -0,0 +1,300 @@
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <string.h>
+#include "history.h"
+#include "eeprom_layout.h"
+#include "watchdog.h"
+
+/*
+	EEPROM image: head:u8 used:u8 base:history_sample_t ring[HISTORY_SIZE] crc:u16.
+	The CRC covers everything before it; a flush torn by a power loss loses
+	the saved history rather than restoring inconsistent records.
+*/
+
+#define HISTORY_RESTART 0x00
+#define HISTORY_RUN 0x80
+#define HISTORY_MAX_RECORD (1 + HISTORY_FIELDS * 3) // mask and 16-bit varints
+
+#define BLOCK_SECS (HISTORY_BLOCK_MS * 0.001f)
+
+static_assert(4 + sizeof(history_sample_t) + HISTORY_SIZE <= EEPROM_HISTORY_SIZE, "history image too large");
+static_assert((4 + sizeof(history_sample_t) + HISTORY_SIZE) * WDT_EEPROM_BYTE_MS <= WDT_MAX_BLOCKING_MS, "history_flush() blocks too long");
+
+#define IMAGE_HEAD_ADDR ((uint8_t *)(uintptr_t)EEPROM_HISTORY_ADDR)
+#define IMAGE_USED_ADDR ((uint8_t *)(uintptr_t)(EEPROM_HISTORY_ADDR + 1))
+#define IMAGE_BASE_ADDR ((void *)(uintptr_t)(EEPROM_HISTORY_ADDR + 2))
+#define IMAGE_RING_ADDR ((void *)(uintptr_t)(EEPROM_HISTORY_ADDR + 2 + sizeof(history_sample_t)))
+#define IMAGE_CRC_ADDR ((uint16_t *)(uintptr_t)(EEPROM_HISTORY_ADDR + 2 + sizeof(history_sample_t) + HISTORY_SIZE))
+
+static uint8_t ring[HISTORY_SIZE];
+static uint8_t head; // next byte to write
+static uint8_t used; // bytes in the ring
+static int16_t run_pos = -1; // position of the newest record if it is a run, else -1
+static history_sample_t base; // values preceding the oldest record
+static history_sample_t last; // values of the newest sample
+
+// averaging of control blocks into the next sample
+static float sums[HISTORY_FIELDS];
+static uint16_t blocks;
+static uint16_t interval_s;
+
+// history_print() cursor
+#define HISTORY_PRINT_ROW_MAX 48 // longest CSV row; fits the 64-byte serial transmit buffer
+static bool printing;
+static bool print_lost; // drop_oldest() ran while printing
+static uint8_t print_pos; // ring position of the next record
+static uint8_t print_done; // record bytes printed
+static uint16_t print_n; // index of the next sample
+static history_sample_t print_sample; // values before the next record
+
+static uint8_t tail()
+{
+	return (uint8_t)((head + HISTORY_SIZE - used) % HISTORY_SIZE);
+}
+
+// pos may run past the end of the ring by up to HISTORY_SIZE - 1
+static uint8_t at(uint16_t pos)
+{
+	return ring[pos % HISTORY_SIZE];
+}
+
+/**
+ * Decode the record at pos, applying its deltas to s. run receives the
+ * number of samples it stands for, 0 for a restart. Returns its length.
+ * */
+static uint8_t decode_record(uint8_t pos, history_sample_t &s, uint8_t &run)
+{
+	uint8_t b = at(pos);
+	if(b == HISTORY_RESTART)
+	{
+		run = 0;
+		return 1;
+	}
+	if(b & HISTORY_RUN)
+	{
+		run = (b & ~HISTORY_RUN) + 1;
+		return 1;
+	}
+
+	uint8_t len = 1;
+	for(uint8_t i = 0; i < HISTORY_FIELDS; ++i)
+	{
+		if(!(b & (1 << i))) continue;
+		uint16_t z = 0;
+		uint8_t shift = 0;
+		uint8_t c;
+		do
+		{
+			c = at((uint16_t)pos + len++);
+			z |= (uint16_t)(c & 0x7f) << shift;
+			shift += 7;
+		} while((c & 0x80) && shift < 16);
+		s.v[i] += (int16_t)((z >> 1) ^ -(z & 1)); // zigzag
+	}
+	run = 1;
+	return len;
+}
+
+static void drop_oldest()
+{
+	uint8_t run;
+	uint8_t pos = tail();
+	if(pos == run_pos) run_pos = -1;
+	if(printing) print_lost = true;
+	used -= decode_record(pos, base, run);
+}
+
+static void append(const uint8_t *rec, uint8_t len)
+{
+	while(HISTORY_SIZE - used < len) drop_oldest();
+	for(uint8_t i = 0; i < len; ++i)
+	{
+		ring[head] = rec[i];
+		head = (head + 1) % HISTORY_SIZE;
+	}
+	used += len;
+}
+
+static void record_sample(const history_sample_t &s)
+{
+	uint8_t rec[HISTORY_MAX_RECORD];
+	uint8_t len = 1;
+	rec[0] = 0;
+	for(uint8_t i = 0; i < HISTORY_FIELDS; ++i)
+	{
+		int16_t d = s.v[i] - last.v[i];
+		if(d == 0) continue;
+		rec[0] |= 1 << i;
+		uint16_t z = ((uint16_t)d << 1) ^ (uint16_t)(d >> 15); // zigzag
+		while(z >= 0x80)
+		{
+			rec[len++] = (z & 0x7f) | 0x80;
+			z >>= 7;
+		}
+		rec[len++] = z;
+	}
+	last = s;
+
+	if(rec[0] != 0)
+	{
+		append(rec, len);
+		run_pos = -1;
+	}
+	else if(run_pos >= 0 && ring[run_pos] != (HISTORY_RUN | (HISTORY_RUN_MAX - 1)))
+	{
+		++ring[run_pos];
+	}
+	else
+	{
+		rec[0] = HISTORY_RUN;
+		append(rec, 1);
+		run_pos = (head + HISTORY_SIZE - 1) % HISTORY_SIZE;
+	}
+}
+
+static uint16_t image_crc()
+{
+	uint16_t crc = 0xffff;
+	crc = _crc16_update(crc, head);
+	crc = _crc16_update(crc, used);
+	for(uint8_t i = 0; i < sizeof(base); ++i)
+		crc = _crc16_update(crc, ((const uint8_t *)&base)[i]);
+	for(uint8_t i = 0; i < HISTORY_SIZE; ++i)
+		crc = _crc16_update(crc, ring[i]);
+	return crc;
+}
+
+void history_init()
+{
+	head = eeprom_read_byte(IMAGE_HEAD_ADDR);
+	used = eeprom_read_byte(IMAGE_USED_ADDR);
+	eeprom_read_block(&base, IMAGE_BASE_ADDR, sizeof(base));
+	eeprom_read_block(ring, IMAGE_RING_ADDR, HISTORY_SIZE);
+	if(head >= HISTORY_SIZE || used > HISTORY_SIZE || image_crc() != eeprom_read_word(IMAGE_CRC_ADDR))
+	{
+		head = used = 0;
+		memset(&base, 0, sizeof(base));
+	}
+
+	// replay the records to find the newest values
+	last = base;
+	for(uint8_t pos = tail(), n = 0; n < used; )
+	{
+		uint8_t run;
+		uint8_t len = decode_record(pos, last, run);
+		pos = (pos + len) % HISTORY_SIZE;
+		n += len;
+	}
+	run_pos = -1;
+
+	if(used)
+	{
+		uint8_t rec = HISTORY_RESTART;
+		append(&rec, 1);
+	}
+}
+
+void history_add(float heater_temp, float air_temp, float heater_set_point, float air_set_point,
+	float power, float interval_secs)
+{
+	sums[HISTORY_HEATER_TEMP] += heater_temp;
+	sums[HISTORY_AIR_TEMP] += air_temp;
+	sums[HISTORY_HEATER_SET_POINT] += heater_set_point;
+	sums[HISTORY_AIR_SET_POINT] += air_set_point;
+	sums[HISTORY_POWER] += power * HISTORY_POWER_STEPS;
+	++blocks;
+
+	interval_s = interval_secs < 1 ? 1 : (interval_secs > UINT16_MAX ? UINT16_MAX : (uint16_t)interval_secs);
+	if(blocks * BLOCK_SECS < interval_s) return;
+
+	history_sample_t s;
+	for(uint8_t i = 0; i < HISTORY_FIELDS; ++i)
+	{
+		float v = sums[i] / blocks;
+		s.v[i] = (int16_t)(v < 0 ? v - 0.5f : v + 0.5f);
+		sums[i] = 0;
+	}
+	blocks = 0;
+	record_sample(s);
+}
+
+void history_flush()
+{
+	eeprom_update_byte(IMAGE_HEAD_ADDR, head);
+	eeprom_update_byte(IMAGE_USED_ADDR, used);
+	eeprom_update_block(&base, IMAGE_BASE_ADDR, sizeof(base));
+	eeprom_update_block(ring, IMAGE_RING_ADDR, HISTORY_SIZE);
+	eeprom_update_word(IMAGE_CRC_ADDR, image_crc());
+}
+
+uint16_t history_dump_length()
+{
+	return HISTORY_HEADER_SIZE + used;
+}
+
+uint8_t history_dump(uint16_t offset, uint8_t *buf, uint8_t len)
+{
+	uint8_t header[HISTORY_HEADER_SIZE];
+	uint16_t age = (uint16_t)(blocks * BLOCK_SECS);
+	header[0] = interval_s & 0xff;
+	header[1] = interval_s >> 8;
+	header[2] = age & 0xff;
+	header[3] = age >> 8;
+	memcpy(header + 4, &base, sizeof(base));
+
+	uint8_t n = 0;
+	for(; n < len && offset < history_dump_length(); ++n, ++offset)
+		buf[n] = offset < HISTORY_HEADER_SIZE ? header[offset] : at((uint16_t)tail() + (offset - HISTORY_HEADER_SIZE));
+	return n;
+}
+
+void history_print()
+{
+	Serial.print(F("history: interval "));
+	Serial.print(interval_s);
+	Serial.print(F(" s\r\nn,heater,air,heater_sp,air_sp,power%,count\r\n"));
+	printing = true;
+	print_lost = false;
+	print_pos = tail();
+	print_done = 0;
+	print_n = 0;
+	print_sample = base;
+}
+
+void history_print_poll()
+{
+	if(!printing || Serial.availableForWrite() < HISTORY_PRINT_ROW_MAX) return;
+	if(print_lost)
+	{
+		// the records before the cursor were folded into the base
+		Serial.print(F("history: changed while printing\r\n"));
+		printing = false;
+		return;
+	}
+	if(print_done >= used)
+	{
+		printing = false;
+		return;
+	}
+
+	uint8_t run;
+	uint8_t len = decode_record(print_pos, print_sample, run);
+	print_pos = (print_pos + len) % HISTORY_SIZE;
+	print_done += len;
+	if(run == 0)
+	{
+		Serial.print(F("restart\r\n"));
+		return;
+	}
+	Serial.print(print_n);
+	for(uint8_t i = 0; i < HISTORY_FIELDS; ++i)
+	{
+		Serial.print(',');
+		Serial.print(i == HISTORY_POWER ? print_sample.v[i] * 100 / HISTORY_POWER_STEPS : print_sample.v[i]);
+	}
+	Serial.print(',');
+	Serial.print(run);
+	Serial.print(F("\r\n"));
+	print_n += run;
+}
@@ -0,0 +1,98 @@
+#ifndef HISTORY_H__
+#define HISTORY_H__
+
+#include <stdint.h>
+
+/*
+	Compressed temperature history.
+
+	Control blocks are averaged over the history interval into a sample of
+	heater and air temperature (1 deg C), both set points and heater power
+	(1/16 steps). Samples are kept in a RAM ring as records relative to the
+	previous sample:
+
+	  0x00                  restart; the time between the neighbours is unknown
+	  0x80 | (n - 1)        n samples (1 to 128) equal to the previous one
+	  mask, delta...        mask bits 0..4 tell which of heater, air, heater set
+	                        point, air set point and power changed; each
+	                        changed field follows as a zigzag varint delta
+
+	A steady hold costs one byte per 128 samples, so hours of history fit in
+	HISTORY_SIZE bytes. When the ring is full the oldest records are folded
+	into the base sample, which holds the absolute values preceding the first
+	record. The ring is copied to EEPROM by history_flush() and restored at
+	boot.
+
+	The dump stream of CMD_GET_HISTORY is the HISTORY_HEADER_SIZE byte header
+	  interval_s:u16 newest_age_s:u16 base:history_sample_t
+	followed by the records from the oldest to the newest.
+*/
+
+#define HISTORY_SIZE 160 // record bytes
+#define HISTORY_POWER_STEPS 16
+#define HISTORY_RUN_MAX 128
+#define HISTORY_BLOCK_MS 256 // interval of history_add() calls
+
+// history_sample_t fields, in record mask bit order
+enum history_field_t : uint8_t
+{
+	HISTORY_HEATER_TEMP,
+	HISTORY_AIR_TEMP,
+	HISTORY_HEATER_SET_POINT,
+	HISTORY_AIR_SET_POINT,
+	HISTORY_POWER, //!< 0 to HISTORY_POWER_STEPS
+
+	HISTORY_FIELDS
+};
+
+/**
+ * one history sample; also the base of the dump stream
+ * */
+struct history_sample_t
+{
+	int16_t v[HISTORY_FIELDS]; //!< indexed by history_field_t; little endian in the dump
+};
+
+#define HISTORY_HEADER_SIZE (4 + sizeof(history_sample_t))
+
+/**
+ * restore the history from EEPROM and mark the restart
+ * */
+void history_init();
+
+/**
+ * Feed one control block; power is 0 to 1. A sample is recorded each time
+ * interval_secs worth of blocks have been averaged.
+ * */
+void history_add(float heater_temp, float air_temp, float heater_set_point, float air_set_point,
+	float power, float interval_secs);
+
+/**
+ * save the history to EEPROM; only changed bytes are written
+ * */
+void history_flush();
+
+/**
+ * Length of the dump stream
+ * */
+uint16_t history_dump_length();
+
+/**
+ * Copy up to len bytes of the dump stream from offset. Returns the number of bytes copied.
+ * */
+uint8_t history_dump(uint16_t offset, uint8_t *buf, uint8_t len);
+
+/**
+ * Start printing the history to serial as CSV, oldest first; a run of equal
+ * samples is one row with its count. The rows are written by
+ * history_print_poll() while the serial transmit buffer has room, so the
+ * main loop is never blocked for long.
+ * */
+void history_print();
+
+/**
+ * Continue a history_print(); call from the main loop
+ * */
+void history_print_poll();
+
+#endif
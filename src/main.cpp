@@ -7,6 +7,25 @@
 #include <math.h>
 #include <stdint.h>
 #include "pid.h"
+#include "checkpoint.h"
+#include "program.h"
+#include "program_builder.h"
+#include "builtin_programs.h"
+#include "prog_store.h"
+#include "serial_proto.h"
+#include "params.h"
+#include "coro.h"
+#include "spsc_ring.h"
+#include "thermal_monitor.h"
+#include "fopdt_model.h"
+#include "ff_table.h"
+#include "eeprom_layout.h"
+#include "watchdog.h"
+#include "history.h"
+#include "capture.h"
+#include "mem_stats.h"
+#include "thermistor_fx.h"
+#include "menu.h"
 #include <TimerOne.h>
 
 // pins
@@ -40,11 +59,29 @@ LiquidCrystal lcd(10, 12, 5,6,7,8);
 // buttons
 #define NUM_BUTTONS 3
 static constexpr uint8_t button_io[] = {2, 4, 3};
-static uint8_t button_counts[NUM_BUTTONS] = {0};
+static_assert(button_io[0] <= 7 && button_io[1] <= 7 && button_io[2] <= 7, "buttons must be on PORTD (PCINT2)");
+static uint8_t button_counts[NUM_BUTTONS] = {0}; // pending presses; accessed from the main loop only
 #define BUTTON_UP 0
 #define BUTTON_DOWN 1
 #define BUTTON_OK 2
 
+/*
+	Buttons are interrupt driven. A falling edge raises PCINT2 and the press
+	is queued at once; further edges are ignored for BUTTON_DEBOUNCE_COUNT
+	ticks of timer1 (~9ms each). While held, the timer tick generates repeats
+	and detects the release. Both handlers run in interrupt context and never
+	nest, so together they are the single producer of button_events; the main
+	loop is its consumer.
+*/
+#define BUTTON_DEBOUNCE_COUNT 4
+#define BUTTON_INITIAL_REPEAT_DELAY 50
+#define BUTTON_REPEAT_LIMIT 56
+
+#define BUTTON_EVENT_REPEAT 0x80 // or'ed to the button index for auto-repeat events
+static spsc_ring_t<uint8_t, 16> button_events;
+static uint8_t button_mask[NUM_BUTTONS]; // PIND bit of each button
+static uint8_t button_held[NUM_BUTTONS]; // ticks the button has been held, 0 if released
+static uint8_t button_lock[NUM_BUTTONS]; // remaining debounce ticks during which edges are ignored
 
 // initialize buttons
 static void init_buttons()
@@ -52,59 +89,87 @@ static void init_buttons()
 	for(uint8_t i = 0; i < NUM_BUTTONS; ++i)
 	{
 		pinMode(button_io[i], INPUT_PULLUP);
+		button_mask[i] = digitalPinToBitMask(button_io[i]);
+		*digitalPinToPCMSK(button_io[i]) |= bit(digitalPinToPCMSKbit(button_io[i]));
 		button_counts[i] = 0;
 	}
-}
-
-// poll buttons
-static uint8_t button_debounce_counter[NUM_BUTTONS] = {0};
+	PCICR |= bit(PCIE2);
 
-#define BUTTON_DEBOUNCE_COUNT 4
-#define BUTTON_INITIAL_REPEAT_DELAY 50
-#define BUTTON_REPEAT_LIMIT 56
+	// discard presses made before now
+	uint8_t ev;
+	while(button_events.pop(ev)) /**/;
+}
 
+// pin change interrupt; catches presses as soon as they happen
+ISR(PCINT2_vect)
+{
+	uint8_t pins = PIND;
+	for(uint8_t i = 0; i < NUM_BUTTONS; ++i)
+	{
+		if(!(pins & button_mask[i]) && !button_held[i] && !button_lock[i])
+		{
+			button_held[i] = 1;
+			button_lock[i] = BUTTON_DEBOUNCE_COUNT;
+			button_events.push(i);
+		}
+	}
+}
 
 /**
- * button update handler called approx. 10ms
+ * button debounce/auto-repeat tick; called from timer1_handler
  */
-static void button_update_handler()
+static void button_tick()
 {
-	EVERY_MS(10)
-		for(int i = 0; i < NUM_BUTTONS; i++)
-		{
-			if(!digitalRead(button_io[i]))
-			{
-				// physical button pressed
-				uint8_t count = button_debounce_counter[i];
-				count ++;
-				if(count == BUTTON_DEBOUNCE_COUNT)
-				{
-					if(button_counts[i] < 255) button_counts[i] ++;
-				}
-				else if(count == BUTTON_REPEAT_LIMIT)
-				{
-					count = BUTTON_INITIAL_REPEAT_DELAY;
-				}
+	uint8_t pins = PIND;
+	for(uint8_t i = 0; i < NUM_BUTTONS; ++i)
+	{
+		if(button_lock[i]) -- button_lock[i];
+		bool down = !(pins & button_mask[i]);
 
-				if(count == BUTTON_INITIAL_REPEAT_DELAY)
-				{
-					if(button_counts[i] < 255) button_counts[i] ++;
-				}
-				button_debounce_counter[i] = count;
-			}
-			else
+		if(!button_held[i])
+		{
+			// a press during the release debounce raised no event
+			if(down && !button_lock[i])
 			{
-				// physical button released
-				button_debounce_counter[i] = 0;
+				button_held[i] = 1;
+				button_lock[i] = BUTTON_DEBOUNCE_COUNT;
+				button_events.push(i);
 			}
 		}
-	END_EVERY_MS
+		else if(down)
+		{
+			uint8_t count = button_held[i] + 1;
+			if(count == BUTTON_REPEAT_LIMIT) count = BUTTON_INITIAL_REPEAT_DELAY;
+			if(count == BUTTON_INITIAL_REPEAT_DELAY) button_events.push(i | BUTTON_EVENT_REPEAT);
+			button_held[i] = count;
+		}
+		else if(!button_lock[i])
+		{
+			// released; ignore the release bounce
+			button_held[i] = 0;
+			button_lock[i] = BUTTON_DEBOUNCE_COUNT;
+		}
+	}
+}
+
+/**
+ * move queued button events to button_counts; called from the main loop
+ */
+static void button_update_handler()
+{
+	uint8_t ev;
+	while(button_events.pop(ev))
+	{
+		uint8_t i = ev & ~BUTTON_EVENT_REPEAT;
+		if(button_counts[i] < 255) button_counts[i] ++;
+	}
 }
 
 
 
 
 #define ADC_VAL_OVERSAMPLE 256
+static_assert(WDT_MAX_BLOCKING_MS + ADC_VAL_OVERSAMPLE < WDT_DEADLINE_TEMP, "a blocked loop stalls manage_temp() past its deadline");
 #define ADC_VAL_MAX 1024
 #define THERMISTOR_T0 298.15f // = 25 deg C
 #define THERMISTOR_B  3950.0f
@@ -121,7 +186,19 @@ static float env_temp = 0;
 #define NUM_HEATER_SENSORS 1
 #define TOTAL_HEATER_TEMP_SENSORS (NUM_HEATER_SENSORS + 2)// +2 = for air&env temperature; so, sensors are: 0:heater 1:air 2:env
 float temps[TOTAL_HEATER_TEMP_SENSORS] = {0}; 
+#ifndef PROFILE_MANAGE_TEMP
+#define PROFILE_MANAGE_TEMP 0 // 1: add the CPU time of manage_temp() to the telemetry as U:
+#endif
+#if PROFILE_MANAGE_TEMP
+static uint32_t profile_sample_us; // sampling time of the current block
+#endif
+#if FIXED_POINT_TEMPS
+static uint32_t adc_sums[TOTAL_HEATER_TEMP_SENSORS]; // raw readings of the current block
+static temp_fx_t temps_fx[TOTAL_HEATER_TEMP_SENSORS]; // temps[] of the last block
+static constexpr thermistor_fx_t thermistor_fx(THERMISTOR_T0, THERMISTOR_B, THERMISTOR_R0, THERMISTOR_RP);
+#endif
 static uint16_t temp_counts = 0;
+static bool temps_valid = false; // whether at least one oversample block has been converted
 
 static void init_temps()
 {
@@ -131,6 +208,9 @@ static void init_temps()
 	air_temp = 0;
 	temp_counts = 0;	
 	for(auto &&x : temps) x = 0;
+#if FIXED_POINT_TEMPS
+	for(auto &&x : adc_sums) x = 0;
+#endif
 }
 
 #define PANIC_TEMPERATURE(X) ((X) < -2  || (X) > 1050) // immidiate panic temperature (thermister failure/open/short)
@@ -139,24 +219,171 @@ static void init_temps()
 //#define SUPRESS_TEMPERATURE(X) ((X) > 280) // temperature which needs heating suppression
 #define TEMP_TARGETABLE_LOW 0 // temperature targetable range: low
 #define TEMP_TARGETABLE_HIGH 400 // temperature targetable range: high
+static_assert(TEMP_TARGETABLE_HIGH == PROG_TEMP_MAX, "program temperature limit mismatch");
 #define TEMP_MAX_HEATER_DIFFERENCE 180 // allowed difference between most hot heater and most cold heater
 #define ANY_HOT_TEMP 50 // warning temperature if any sensor is avobe this
 static float heater_power_target = 0; // heater power designated by PID controller
-static volatile float heater_power = 0; // last heater power
+#if FIXED_POINT_TEMPS
+typedef int16_t heater_power_t;
+#else
+typedef float heater_power_t;
+#endif
+static volatile heater_power_t heater_power = 0; // last heater power
+static volatile uint32_t heater_on_ticks = 0; // timer1 ticks with the heater on; energy meter
 static bool any_hot = false;
-#define AIR_TEMP_LPF_COEFF 0.2 // air temperature IIR LPF coeff
+#define AIR_TEMP_LPF_COEFF 0.2 // air temperature IIR LPF coeff; default of air_temp_lpf_coeff
 #define HEATER_POWER_MAX 256
 #define HEATER_POWER_INCREMENT 90
 #define HEATER_POWER_DECREMENT 70
+#define HEATER_WATTS 800 // rated power of the heater element; default of heater_watts
+static float air_temp_lpf_coeff = AIR_TEMP_LPF_COEFF;
+static float heater_power_increment = HEATER_POWER_INCREMENT;
+static float heater_power_decrement = HEATER_POWER_DECREMENT;
+static float heater_watts = HEATER_WATTS;
+#define FEED_FORWARD_GAIN 1.0 // scale of the learned feed-forward power; 0 disables it
+static float feed_forward_gain = FEED_FORWARD_GAIN;
+#define HISTORY_INTERVAL 60 // seconds per history sample; default of history_interval
+#define HISTORY_FLUSH_MS (15ul * 60 * 1000) // interval of history saves to EEPROM
+static float history_interval = HISTORY_INTERVAL;
+
+// slow EEPROM writes requested by the tasks; loop() runs one per pass
+static bool params_commit_requested = false;
+static bool history_flush_requested = false;
+
+static ff_table_t heater_ff(EEPROM_HEATER_FF_ADDR);
+static ff_table_t air_ff(EEPROM_AIR_FF_ADDR);
+
+#define PWM_FREQ 110 // timer1 interrupt rate, Hz
+
+// read the energy meter
+static uint32_t get_heater_on_ticks()
+{
+	noInterrupts();
+	uint32_t t = heater_on_ticks;
+	interrupts();
+	return t;
+}
+
+// energy in Wh of a number of heater-on ticks
+static float heater_ticks_to_wh(uint32_t ticks)
+{
+	return (float)ticks * (heater_watts * (1.0f / (PWM_FREQ * 3600.0f)));
+}
 
 static pid_controller_t heater_pid(6, 1, 1200, 512, 1, 0.5, 40, 0, HEATER_POWER_MAX);
 #define AIR_BASE_P 30
 #define AIR_BASE_I 1
 #define AIR_BASE_D 600
 static pid_controller_t air_pid(AIR_BASE_P, AIR_BASE_I, AIR_BASE_D, 512, 1, 0.5, 40, 0, HEATER_POWER_MAX);
+static float air_base_p = AIR_BASE_P; // tunable over serial
+static float air_base_i = AIR_BASE_I;
 #define AIR_PID_PARAM_ADJUST \
-	air_pid.kp = air_pid.setpoint >= 140 ? AIR_BASE_P * 1 : (air_pid.setpoint >= 80 ? AIR_BASE_P * 1 : AIR_BASE_P); \
-	air_pid.ki = air_pid.setpoint >= 140 ? AIR_BASE_I * 1 : (air_pid.setpoint >= 80 ? AIR_BASE_I * 1 : AIR_BASE_I);
+	air_pid.kp = air_pid.setpoint >= 140 ? air_base_p * 1 : (air_pid.setpoint >= 80 ? air_base_p * 1 : air_base_p); \
+	air_pid.ki = air_pid.setpoint >= 140 ? air_base_i * 1 : (air_pid.setpoint >= 80 ? air_base_i * 1 : air_base_i);
+
+// parameters accessible over serial, indexed by param_id_t
+static float * const PARAMS[] PROGMEM = {
+	&heater_set_point,
+	&air_set_point,
+
+	&heater_pid.kp,
+	&heater_pid.ki,
+	&heater_pid.kd,
+	&heater_pid.kilim,
+	&heater_pid.kirc,
+	&heater_pid.kdc,
+	&heater_pid.effective_range,
+	&heater_pid.low_limit,
+	&heater_pid.high_limit,
+
+	&air_base_p, // air_pid.kp is derived by AIR_PID_PARAM_ADJUST
+	&air_base_i,
+	&air_pid.kd,
+	&air_pid.kilim,
+	&air_pid.kirc,
+	&air_pid.kdc,
+	&air_pid.effective_range,
+	&air_pid.low_limit,
+	&air_pid.high_limit,
+
+	&heater_power_increment,
+	&heater_power_decrement,
+	&air_temp_lpf_coeff,
+	&heater_watts,
+	&feed_forward_gain,
+	&history_interval,
+};
+static_assert(sizeof(PARAMS) / sizeof(PARAMS[0]) == NUM_PARAMS, "PARAMS must list every param_id_t");
+
+// accepted ranges, indexed by param_id_t; the menu editors use them too
+static const param_limits_t PARAM_LIMITS[] PROGMEM = {
+	{ TEMP_TARGETABLE_LOW, TEMP_TARGETABLE_HIGH }, // heater_set_point
+	{ TEMP_TARGETABLE_LOW, TEMP_TARGETABLE_HIGH }, // air_set_point
+
+	{ 0, 100 }, // kp
+	{ 0, 10 }, // ki
+	{ 0, 5000 }, // kd
+	{ 0, 4 * HEATER_POWER_MAX }, // kilim
+	{ 0, 1 }, // kirc
+	{ 0, 1 }, // kdc
+	{ 0, TEMP_TARGETABLE_HIGH }, // effective_range
+	{ 0, HEATER_POWER_MAX }, // low_limit
+	{ 0, HEATER_POWER_MAX }, // high_limit
+
+	{ 0, 100 }, // air_base_p
+	{ 0, 10 }, // air_base_i
+	{ 0, 5000 }, // kd
+	{ 0, 4 * HEATER_POWER_MAX }, // kilim
+	{ 0, 1 }, // kirc
+	{ 0, 1 }, // kdc
+	{ 0, TEMP_TARGETABLE_HIGH }, // effective_range
+	{ 0, HEATER_POWER_MAX }, // low_limit
+	{ 0, HEATER_POWER_MAX }, // high_limit
+
+	{ 1, HEATER_POWER_MAX }, // heater_power_increment; 0 would never turn the heater up
+	{ 1, HEATER_POWER_MAX }, // heater_power_decrement; 0 would never turn it down
+	{ 0.01, 1 }, // air_temp_lpf_coeff; 0 would freeze the air temperature
+	{ 0, 5000 }, // heater_watts
+	{ 0, 2 }, // feed_forward_gain
+	{ 1, 3600 }, // history_interval
+};
+static_assert(sizeof(PARAM_LIMITS) / sizeof(PARAM_LIMITS[0]) == NUM_PARAMS, "PARAM_LIMITS must list every param_id_t");
+
+float *param_ptr(uint8_t id)
+{
+	return (float *)pgm_read_ptr(&PARAMS[id]);
+}
+
+param_limits_t param_limits(uint8_t id)
+{
+	param_limits_t l;
+	memcpy_P(&l, &PARAM_LIMITS[id], sizeof(l));
+	return l;
+}
+
+// parameter updates received over serial, applied together at the next control cycle
+#define MAX_PENDING_PARAMS (SERIAL_PROTO_MAX_PAYLOAD / 5)
+static uint8_t pending_param_ids[MAX_PENDING_PARAMS];
+static float pending_param_values[MAX_PENDING_PARAMS];
+static uint8_t num_pending_params = 0;
+
+static void apply_pending_params()
+{
+	for(uint8_t i = 0; i < num_pending_params; ++i)
+		*param_ptr(pending_param_ids[i]) = pending_param_values[i];
+	num_pending_params = 0;
+}
+
+/**
+ * value the parameter will have once the pending batch is applied
+ * */
+static float pending_param_value(uint8_t id)
+{
+	float v = *param_ptr(id);
+	for(uint8_t i = 0; i < num_pending_params; ++i)
+		if(pending_param_ids[i] == id) v = pending_param_values[i];
+	return v;
+}
 
 #define PID_SETPOINT_OFFSET 0.0
 
@@ -209,8 +436,19 @@ static void display(const String &n)
 // panic handler
 static void panic(const String &n)
 {
+	// stop the PWM before anything slow; the diagnostics below take seconds
+	// and need interrupts for serial output
+	heater_power = 0;
+	Timer1.detachInterrupt();
 	pinMode(HEATER_PIN, OUTPUT);
 	digitalWrite(HEATER_PIN, LOW); // disable heater
+	watchdog_stop(); // halt here rather than reset and resume the program
+	history_flush(); // keep the lead-up to the fault
+	capture_freeze(CAPTURE_TRIG_PANIC);
+#if CAPTURE_SAMPLES
+	capture_print();
+	while(!capture_print_poll()) {}
+#endif
 	display(String(F("!!!Panic!!!\r\n")) + n);
 	Serial.flush();
 	cli();
@@ -239,15 +477,11 @@ static float oversample_adc(int num)
 }
 #endif
 
-// measure adc with no oversampling
-static float measure_adc(int num)
+#if !FIXED_POINT_TEMPS
+// normalize one adc reading
+static float normalize_adc(uint16_t raw)
 {
-	uint32_t accum = 0;
-	for(int i = 0; i < 1; ++i)
-	{
-		accum += analogRead(num);
-	}
-	return (float)accum *
+	return (float)raw *
 		(1.0 / ((float)1.0 * (float)ADC_VAL_MAX)) +
 		(1.0/ADC_VAL_MAX/2.0);
 }
@@ -261,6 +495,56 @@ static float adc_val_to_temp(float adc_val_normalized)
 		(THERMISTOR_T0 * log(r / THERMISTOR_R0) + THERMISTOR_B);
 	return res - 273.15;
 }
+#endif
+
+// telemetry of one sensor of the last block
+static void print_sensor_temp(uint8_t i)
+{
+#if FIXED_POINT_TEMPS
+	temp_fx_print(temps_fx[i]);
+#else
+	Serial.print(temps[i]);
+#endif
+}
+
+// model-based sensor/heater fault monitors: gain (deg C at full power),
+// tau (s), dead time (s), max rate (deg C/s). The models are lower bounds
+// of a healthy oven, fitted to tools/sweep/oven_model.h and checked by
+// test/test_thermal_monitor.cpp
+static_assert(THERMAL_MONITOR_BLOCK_MS == ADC_VAL_OVERSAMPLE, "monitor interval must be one oversample block");
+static thermal_monitor_t heater_monitor(150, 100, 0, 20);
+static thermal_monitor_t air_monitor(120, 700, 60, 10);
+
+// online response models for wait time prediction; initial gain and tau
+static_assert(FOPDT_BLOCK_MS == ADC_VAL_OVERSAMPLE, "model interval must be one oversample block");
+static fopdt_model_t heater_model(600, 60);
+static fopdt_model_t air_model(300, 300);
+
+static_assert(HISTORY_BLOCK_MS == ADC_VAL_OVERSAMPLE, "history interval must be one oversample block");
+
+// conditions at the previous block, for the capture triggers
+static_assert(CAPTURE_CHANNELS == TOTAL_HEATER_TEMP_SENSORS, "capture must record every sensor");
+#if CAPTURE_SAMPLES
+static float capture_heater_set_point;
+static float capture_air_set_point;
+static bool capture_saturated;
+#endif
+
+// panic if the monitor detected a fault
+static void check_thermal_fault(thermal_fault_t f, const __FlashStringHelper *sensor)
+{
+	if(f == THERMAL_OK) return;
+	String msg(sensor);
+	switch(f)
+	{
+	case THERMAL_RATE: msg += F(" jumps"); break;
+	case THERMAL_STUCK: msg += F(" stuck"); break;
+	case THERMAL_NO_RISE: msg += F(" no rise"); break;
+	case THERMAL_RUNAWAY: msg += F(" runaway"); break;
+	default:;
+	}
+	panic(msg);
+}
 
 // bit reverset - 8bit
 static uint8_t bit_reverse(uint8_t v)
@@ -276,15 +560,30 @@ static uint8_t bit_reverse(uint8_t v)
 static void manage_temp()
 {
 	EVERY_MS(1)
+#if PROFILE_MANAGE_TEMP
+		uint32_t profile_t0 = micros();
+#endif
 		// measure temperatures
-
+		uint16_t raw[TOTAL_HEATER_TEMP_SENSORS];
 		for(uint8_t i = 0; i < TOTAL_HEATER_TEMP_SENSORS; ++i)
 		{
-			float t = measure_adc(i);
-			temps[i] += t;
+			raw[i] = analogRead(i);
+#if FIXED_POINT_TEMPS
+			adc_sums[i] += raw[i];
+#else
+			temps[i] += normalize_adc(raw[i]);
+#endif
 		}
+#if CAPTURE_SAMPLES
+		// not even evaluated without the capture: this runs every millisecond
+		capture_add(raw, heater_power >= 255 ? 255 : (uint8_t)heater_power, digitalRead(HEATER_PIN));
+#endif
 
 		++temp_counts;
+#if PROFILE_MANAGE_TEMP
+		profile_sample_us += micros() - profile_t0;
+		profile_t0 = micros();
+#endif
 		if(temp_counts >= ADC_VAL_OVERSAMPLE)
 		{
 			temp_counts = 0;
@@ -292,10 +591,19 @@ static void manage_temp()
 			any_hot = false;
 
 			// convert adc value to temperature
+#if FIXED_POINT_TEMPS
+			for(uint8_t i = 0; i < TOTAL_HEATER_TEMP_SENSORS; ++i)
+			{
+				temps_fx[i] = thermistor_fx.convert(adc_sums[i] + ADC_VAL_OVERSAMPLE / 2,
+					(uint32_t)ADC_VAL_OVERSAMPLE * ADC_VAL_MAX);
+				temps[i] = temps_fx[i] * (1.0f / TEMP_FX_ONE); // for the block-rate consumers
+			}
+#else
 			for(auto && v : temps)
 			{
 				v = adc_val_to_temp(v*(1.0 / ADC_VAL_OVERSAMPLE));
 			}
+#endif
 
 			// check heaters
 			float heater_min = temps[0];
@@ -312,7 +620,7 @@ static void manage_temp()
 				Serial.print(F("H"));
 				Serial.print((int)i);
 				Serial.print(':');
-				Serial.print(tmp);
+				print_sensor_temp(i);
 				Serial.print(' ');
 				if(PANIC_TEMPERATURE(tmp))
 				{
@@ -334,10 +642,10 @@ static void manage_temp()
 			if(tmp >= ANY_HOT_TEMP) any_hot = true;
 
 			// store air temperature
-			air_temp += (tmp - air_temp) * AIR_TEMP_LPF_COEFF;
+			air_temp += (tmp - air_temp) * air_temp_lpf_coeff;
 			Serial.print(F("A"));
 			Serial.print(':');
-			Serial.print(tmp);
+			print_sensor_temp(AIR_TEMP_IDX);
 			Serial.print(' ');
 			if(PANIC_TEMPERATURE(tmp))
 				panic(F("Air"));
@@ -350,17 +658,48 @@ static void manage_temp()
 			env_temp = tmp;
 			Serial.print(F("E"));
 			Serial.print(':');
-			Serial.print(tmp);
+			print_sensor_temp(ENV_TEMP_IDX);
 			if(PANIC_TEMPERATURE(tmp)) // TODO: check env temp limit
 				panic(F("Env"));
 
+			// check responses against the heater power applied during this block
+			float applied_power = heater_power * (1.0f / HEATER_POWER_MAX);
+			check_thermal_fault(heater_monitor.update(heater_temp, env_temp, applied_power), F("Heater"));
+			check_thermal_fault(air_monitor.update(temps[AIR_TEMP_IDX], env_temp, applied_power), F("Air"));
+			heater_model.update(heater_temp, env_temp, applied_power);
+			air_model.update(temps[AIR_TEMP_IDX], env_temp, applied_power);
+			history_add(heater_temp, air_temp, heater_set_point, air_set_point, applied_power, history_interval);
+
 			// clear all accumurators
+#if FIXED_POINT_TEMPS
+			for(auto &&x : adc_sums) x = 0;
+#else
 			for(auto &&x : temps) x = 0;
+#endif
+
+			// apply parameter updates between control cycles
+			apply_pending_params();
+
+#if CAPTURE_SAMPLES
+			// capture triggers
+			if(heater_set_point != capture_heater_set_point || air_set_point != capture_air_set_point)
+				capture_trigger(CAPTURE_TRIG_SET_POINT);
+			capture_heater_set_point = heater_set_point;
+			capture_air_set_point = air_set_point;
+#endif
 
 			// update pid values
 			heater_pid.set_set_point(heater_set_point + PID_SETPOINT_OFFSET);
 			air_pid.set_set_point(air_set_point + PID_SETPOINT_OFFSET);
 			AIR_PID_PARAM_ADJUST;
+			heater_pid.feed_forward = heater_ff.lookup(heater_set_point, env_temp) * feed_forward_gain;
+			air_pid.feed_forward = air_ff.lookup(air_set_point, env_temp) * feed_forward_gain;
+
+			// learn the hold power of the followed set point
+			if(air_set_point > 0.0f)
+				air_ff.learn(air_set_point, air_temp, env_temp, applied_power * HEATER_POWER_MAX);
+			else if(heater_set_point > 0.0f)
+				heater_ff.learn(heater_set_point, heater_temp, env_temp, applied_power * HEATER_POWER_MAX);
 
 			// decide which temperature should to be reached
 			float air_value, heater_value;
@@ -377,6 +716,12 @@ static void manage_temp()
 				// follow heater set point
 				heater_power_target = heater_value;
 			}
+#if CAPTURE_SAMPLES
+			bool saturated = air_set_point > 0.0f ? air_pid.saturated() : heater_pid.saturated();
+			if(saturated != capture_saturated)
+				capture_trigger(CAPTURE_TRIG_RANGE);
+			capture_saturated = saturated;
+#endif
 
 			// needs suppression?
 			if(SUPRESS_TEMPERATURE(heater_temp)||
@@ -384,20 +729,23 @@ static void manage_temp()
 				)
 			{
 				heater_power_target = 0;
+				capture_trigger(CAPTURE_TRIG_SUPPRESS);
 			}
 
-			// accumulate heater power
-			float hp = heater_power;
-			if(hp < heater_power_target)
+			// accumulate heater power; the PID output and the rates are
+			// converted once, so the integer build slews in integers
+			heater_power_t hp = heater_power;
+			heater_power_t target = heater_power_target;
+			if(hp < target)
 			{
-					hp += HEATER_POWER_INCREMENT;
-					if(hp > heater_power_target) hp = heater_power_target;
+					hp += (heater_power_t)heater_power_increment;
+					if(hp > target) hp = target;
 					if(hp > HEATER_POWER_MAX) hp = HEATER_POWER_MAX;
 			}
-			else if(hp > heater_power_target)
+			else if(hp > target)
 			{
-					hp -= HEATER_POWER_DECREMENT;
-					if(hp < heater_power_target) hp = heater_power_target;
+					hp -= (heater_power_t)heater_power_decrement;
+					if(hp < target) hp = target;
 					if(hp < 0) hp = 0;
 			}
 
@@ -409,22 +757,56 @@ static void manage_temp()
 			heater_power = hp;
 			interrupts();
 
+#if PROFILE_MANAGE_TEMP
+			// mean sampling time per ms / block processing time, us
+			uint32_t profile_block_us = micros() - profile_t0;
+#endif
+
 			// dump
 			Serial.print(F(" P:"));
 			Serial.print((int)heater_power_target);
 			Serial.print(F("/"));
 			Serial.print((int)hp);
+			Serial.print(F(" T:"));
+			PRINT_REAL(heater_set_point);
+			Serial.print('/');
+			PRINT_REAL(air_set_point);
+			Serial.print(F(" Wh:"));
+			PRINT_REAL(heater_ticks_to_wh(get_heater_on_ticks()));
+			{
+				// model of the followed temperature: tau/gain/dead time/one-step error
+				const fopdt_model_t &m = air_set_point > 0.0f ? air_model : heater_model;
+				Serial.print(F(" M:"));
+				PRINT_REAL(m.tau());
+				Serial.print('/');
+				PRINT_REAL(m.gain());
+				Serial.print('/');
+				PRINT_REAL(m.dead_time());
+				Serial.print('/');
+				PRINT_REAL(m.error());
+			}
+#if PROFILE_MANAGE_TEMP
+			Serial.print(F(" U:"));
+			Serial.print(profile_sample_us / ADC_VAL_OVERSAMPLE);
+			Serial.print('/');
+			Serial.print(profile_block_us);
+			profile_sample_us = 0;
+#endif
 			Serial.print(F("\r\n"));
 
 			if(air_set_point > 0.0f)
 				air_pid.dump();
 			else
 				heater_pid.dump();
+
+			temps_valid = true;
 		}
 	END_EVERY_MS
 
 	// set status led and enable fan if any sensor detected hot condition
 	set_led(any_hot);
+
+	watchdog_checkin(WDT_TASK_TEMP);
 }
 
 
@@ -437,14 +819,25 @@ void timer1_handler(void)
 	if((uint16_t)bit_reverse(count % HEATER_POWER_MAX) < (uint16_t)heater_power)
 	{
 		digitalWrite(HEATER_PIN, HIGH);
+		++heater_on_ticks;
 	}
 	else
 	{
 		digitalWrite(HEATER_PIN, LOW);
 	}
+
+	button_tick();
+
+	watchdog_checkin(WDT_TASK_TIMER);
 }
 
-static int32_t secs_remain;
+// the WDT is about to reset the MCU; timer1 is stopped along with all other
+// interrupts, so make sure it has not left the heater on
+void watchdog_expired()
+{
+	heater_power = 0;
+	digitalWrite(HEATER_PIN, LOW);
+}
 
 static void update_status_display(const String & status)
 {
@@ -457,266 +850,647 @@ static void update_status_display(const String & status)
 	END_EVERY_MS
 }
 
-// simple continuation implementation
-#define YIELD2(COUNTER) \
-	do { \
-	state = COUNTER; \
-	return; \
-	case COUNTER:; \
-	} while(0)
-
-#define YIELD YIELD2(__COUNTER__)
-
-
-#define MENU_PROG1 0
-#define MENU_PROG2 1
-#define MENU_SET_HEATER 2
-#define MENU_SET_AIR 3
-
-#define MAX_MENU_ITEM 5 // last menu item must be empty string
-static String menu[MAX_MENU_ITEM];
-static uint8_t menu_selected_index = 0;
-static uint8_t menu_item_first_index = 0;
+// set point adjusted on the status screen after it is set from the menu
+enum hold_mode_t : uint8_t
+{
+	HOLD_NONE,
+	HOLD_HEATER,
+	HOLD_AIR,
+};
 
-static void init_menu()
+static void handle_status_keys(uint8_t mode)
 {
-	init_buttons();
-	for(uint8_t i = 0; i < MAX_MENU_ITEM; ++i) menu[i] = String();
-	menu_selected_index = 0;
-	menu_item_first_index = 0;
+	float &set_point = mode == HOLD_HEATER ? heater_set_point : air_set_point;
+	int16_t t = set_point;
+	// for only up/down
+	while(button_counts[BUTTON_UP]--)
+	{
+		if(t < TEMP_TARGETABLE_HIGH) ++t;
+	}
+	button_counts[BUTTON_UP] = 0;
+	while(button_counts[BUTTON_DOWN]--)
+	{
+		if(t > TEMP_TARGETABLE_LOW) --t;
+	}
+	button_counts[BUTTON_DOWN] = 0;
+	set_point = t;
 }
 
-static void add_menu(const String &item)
+
+static uint32_t tone_pattern = 0;
+static bool tone_repeat = false;
+static uint8_t tone_position = 0; 
+static void tone_handler()
 {
-	for(uint8_t i = 0; i < MAX_MENU_ITEM; ++i)
+	EVERY_MS(100)
 	{
-		if(menu[i].length() == 0)
+		if(tone_pattern & ((uint32_t)1<<tone_position))
 		{
-			menu[i] = item;
-			break;
+			tone(TONE_PIN, 2000);
+		}
+		else
+		{
+			noTone(TONE_PIN);	
 		}
+		
+		++ tone_position;
+		if(tone_position >= 32)
+		{
+			if(tone_repeat)
+				tone_position = 0;
+			else
+				tone_position = 0, tone_pattern = 0;
+		}
+			
 	}
+	END_EVERY_MS
 }
 
-static void justify_menu_show_range_up()
+static void set_tone_pattern(uint32_t pattern, bool repeat)
 {
-	if(menu_selected_index < menu_item_first_index)
-		menu_item_first_index = menu_selected_index;
+	tone_pattern = pattern;
+	tone_repeat = repeat;
+	tone_position = 0;
 }
-static void justify_menu_show_range_down()
+
+#define TEMP_MATCH_MARGIN 1.5
+#define ETA_REPLAN_MS 10000 // interval to refresh the prediction of the rest of the program
+
+static const uint16_t * const PROGRAMS[] = { PROG1.words, PROG2.words };
+#define NUM_BUILTIN_PROGRAMS (sizeof(PROGRAMS) / sizeof(PROGRAMS[0]))
+#define NUM_PROGRAMS (NUM_BUILTIN_PROGRAMS + PROG_STORE_SLOTS) // built-in programs, then EEPROM slots
+
+// CORO_AWAIT that checks the task in each time the condition is evaluated:
+// waiting where it should is progress
+#define CORO_AWAIT_CHECKIN(COND, TASK) CORO_AWAIT((watchdog_checkin(TASK), (COND)))
+
+// program runner
+class prog_runner_t : public coro_t
+{
+	uint8_t prog; //!< running program index, or CHECKPOINT_NO_PROGRAM
+	uint16_t ip; //!< instruction pointer
+	uint8_t opcode; //!< current instruction
+	uint32_t arg;
+	uint8_t insn_len;
+	int32_t secs; //!< remaining dwell seconds
+	uint32_t deadline; //!< end of the current dwell second
+	bool resuming; //!< continuing the current instruction from a checkpoint
+	bool button_wait; //!< waiting for OK in PROG_WAIT_BUTTON
+	uint32_t prog_ticks; //!< energy meter reading at the program start
+	uint32_t step_ticks; //!< energy meter reading at the instruction start
+	uint32_t end_ticks; //!< energy meter reading at the program end
+	uint32_t wait_start; //!< millis() at the start of the current wait
+	int32_t wait_predicted; //!< predicted duration of the current wait, or -1
+	int32_t rest_secs; //!< predicted duration of the instructions after the current one, or -1
+	uint32_t rest_time; //!< millis() when rest_secs was computed
+	prog_reader_t reader;
+
+	bool open(uint8_t index);
+	void save_checkpoint(bool force);
+	void finish();
+	bool temp_reached() const;
+	int32_t wait_secs() const;
+	void plan_rest();
+
+public:
+	prog_runner_t() : prog(CHECKPOINT_NO_PROGRAM), ip(0), opcode(0), arg(0), insn_len(0), secs(0), deadline(0),
+		resuming(false), button_wait(false), prog_ticks(0), step_ticks(0), end_ticks(0),
+		wait_start(0), wait_predicted(-1), rest_secs(-1), rest_time(0) { cancel(); }
+
+	void run() override;
+
+	/**
+	 * start the program from the beginning. returns false if the program does not exist.
+	 * */
+	bool start(uint8_t index);
+
+	/**
+	 * continue the program interrupted by power loss. returns false if nothing to resume.
+	 * */
+	bool resume();
+
+	/**
+	 * abort the running program
+	 * */
+	void stop() { finish(); cancel(); }
+
+	bool running() const { return prog != CHECKPOINT_NO_PROGRAM; }
+	uint8_t program() const { return prog; }
+	uint16_t position() const { return ip; }
+	int32_t secs_remain() const { return secs; }
+
+	/**
+	 * heater energy of the running program, or of the last one, in Wh
+	 * */
+	float energy_wh() const { return heater_ticks_to_wh((running() ? get_heater_on_ticks() : end_ticks) - prog_ticks); }
+
+	/**
+	 * predicted seconds until the program ends, or -1 if unknown
+	 * */
+	int32_t eta_secs();
+
+	/**
+	 * whether PROG_WAIT_BUTTON is waiting for OK; button_pressed() lets it continue
+	 * */
+	bool waiting_for_button() const { return button_wait; }
+	void button_pressed() { button_wait = false; }
+};
+
+// prepare the reader for the program. returns false if the program does not exist.
+bool prog_runner_t::open(uint8_t index)
 {
-	if(menu_item_first_index + LCD_LINES >= menu_selected_index)
-		menu_item_first_index = menu_selected_index - LCD_LINES + 1;
+	if(index < NUM_BUILTIN_PROGRAMS)
+	{
+		reader.open_flash(PROGRAMS[index]);
+		prog_store_lock(PROG_STORE_SLOTS);
+		return true;
+	}
+
+	uint8_t slot = index - NUM_BUILTIN_PROGRAMS;
+	char name[PROG_STORE_NAME_LEN];
+	if(slot >= PROG_STORE_SLOTS || !prog_store_get_name(slot, name)) return false;
+	reader.open_store(slot);
+	prog_store_lock(slot);
+	return true;
 }
 
-#if 0 // unused
-static void justify_menu_show_range()
+// save program state to EEPROM; forced writes bypass the rate limit
+void prog_runner_t::save_checkpoint(bool force)
 {
-	justify_menu_show_range_up();
-	justify_menu_show_range_down();
+	checkpoint_t cp;
+	cp.prog = prog;
+	cp.ip = ip;
+	cp.secs_remain = secs;
+	cp.heater_set_point = (int16_t)heater_set_point;
+	cp.air_set_point = (int16_t)air_set_point;
+	checkpoint_save(cp, force);
 }
 
-static void set_selected_menu_index(uint8_t index)
+void prog_runner_t::finish()
 {
-	menu_selected_index = index;
-	justify_menu_show_range();
+	if(!running()) return;
+	end_ticks = get_heater_on_ticks();
+	// stop heating now; the energy report is shown for up to a minute
+	// before the main screen resets the temperatures
+	heater_set_point = 0;
+	air_set_point = 0;
+	prog = CHECKPOINT_NO_PROGRAM;
+	button_wait = false;
+	prog_store_lock(PROG_STORE_SLOTS);
+	checkpoint_clear();
+	history_flush_requested = true;
+	watchdog_idle(WDT_TASK_PROG);
 }
-#endif
 
-static void show_menus()
+bool prog_runner_t::temp_reached() const
 {
-	String lines;
-	for(uint8_t i = 0; i < LCD_LINES; ++i)
-	{
-		if(i + menu_item_first_index == menu_selected_index) lines += '>'; else lines += ' ';
-		lines += menu[i + menu_item_first_index] + F("\r\n");;
-	}
-	display(lines);
+	float t = (opcode == PROG_WAIT_HEATER_TEMP || opcode == PROG_SET_WAIT_HEATER_TEMP) ? heater_temp : air_temp;
+	return t - TEMP_MATCH_MARGIN <= (int16_t)arg && (int16_t)arg <= t + TEMP_MATCH_MARGIN;
 }
 
-static void menu_handle_keys()
+static bool is_wait_op(uint8_t op)
 {
-	// for only up/down
-	while(button_counts[BUTTON_UP]--)
-	{
-		if(menu_selected_index > 0) --menu_selected_index;
-		justify_menu_show_range_up();
-	}
-	button_counts[BUTTON_UP] = 0;
-	while(button_counts[BUTTON_DOWN]--)
-	{
-		++menu_selected_index;
-		if(menu[menu_selected_index].length() == 0) --menu_selected_index;
-		justify_menu_show_range_down();
-	}
-	button_counts[BUTTON_DOWN] = 0;
+	return op == PROG_WAIT_HEATER_TEMP || op == PROG_WAIT_AIR_TEMP ||
+		op == PROG_SET_WAIT_HEATER_TEMP || op == PROG_SET_WAIT_AIR_TEMP;
 }
 
-static int16_t menu_temp = 0;
-static void init_set_temp()
+static bool is_heater_op(uint8_t op)
 {
-	menu_temp = TEMP_TARGETABLE_LOW;
+	return op == PROG_SET_HEATER_TEMP || op == PROG_WAIT_HEATER_TEMP || op == PROG_SET_WAIT_HEATER_TEMP;
 }
 
-static void handle_temp_keys()
+// predicted seconds until a temperature wait from `from` to `target` ends,
+// not including the dead time, or -1 if unknown
+static int32_t predict_wait(bool heater, float from, int16_t target)
 {
-	// for only up/down
-	while(button_counts[BUTTON_UP]--)
-	{
-		if(menu_temp < TEMP_TARGETABLE_HIGH) ++menu_temp;
-	}
-	button_counts[BUTTON_UP] = 0;
-	while(button_counts[BUTTON_DOWN]--)
-	{
-		if(menu_temp > TEMP_TARGETABLE_LOW) --menu_temp;
-	}
-	button_counts[BUTTON_DOWN] = 0;
+	if(from - TEMP_MATCH_MARGIN <= target && target <= from + TEMP_MATCH_MARGIN) return 0;
+	float to = target > from ? target - TEMP_MATCH_MARGIN : target + TEMP_MATCH_MARGIN;
+	return (heater ? heater_model : air_model).predict_secs(from, to, env_temp);
 }
 
-static void show_temps(const String &n)
+// predicted remaining seconds of the current wait, or -1
+int32_t prog_runner_t::wait_secs() const
 {
-	String lines = n + F("\r\n") + String((int)menu_temp);
-	display(lines);
+	if(temp_reached()) return 0;
+	bool heater = is_heater_op(opcode);
+	const fopdt_model_t &m = heater ? heater_model : air_model;
+	int32_t secs = predict_wait(heater, heater ? heater_temp : air_temp, (int16_t)arg);
+	if(secs < 0) return -1;
+	int32_t dead = (int32_t)m.dead_time() - (int32_t)((millis() - wait_start) / 1000);
+	return dead > 0 ? secs + dead : secs;
 }
 
-static void set_menu_temp(uint8_t mode)
+// predict the duration of the instructions after the current one. a set point
+// is assumed to be reached during a dwell, and every temperature wait to start
+// from the temperature reached last.
+void prog_runner_t::plan_rest()
 {
-	if(mode == MENU_SET_HEATER)
-		menu_temp = heater_set_point;
-	else if(mode == MENU_SET_AIR)
-		menu_temp = air_set_point;
+	rest_time = millis();
+	rest_secs = 0;
+
+	float planned[2], pending[2]; // air, heater
+	planned[0] = air_temp;
+	planned[1] = heater_temp;
+	pending[0] = air_set_point;
+	pending[1] = heater_set_point;
+	if(is_wait_op(opcode))
+		planned[is_heater_op(opcode)] = (int16_t)arg;
+	else if(opcode == PROG_DWELL || opcode == PROG_DWELL_MIN)
+		planned[0] = pending[0], planned[1] = pending[1];
+
+	uint16_t pos = ip + insn_len;
+	for(uint8_t n = 0; n < UINT8_MAX; ++n)
+	{
+		uint8_t op;
+		uint32_t a;
+		pos += reader.fetch(pos, op, a);
+		if(op == PROG_END) return;
+
+		bool heater = is_heater_op(op);
+		if(op == PROG_DWELL || op == PROG_DWELL_MIN)
+		{
+			rest_secs += op == PROG_DWELL ? a : a * 60;
+			planned[0] = pending[0];
+			planned[1] = pending[1];
+		}
+		else if(op == PROG_SET_HEATER_TEMP || op == PROG_SET_AIR_TEMP)
+		{
+			pending[heater] = (int16_t)a;
+		}
+		else if(is_wait_op(op))
+		{
+			int32_t secs = predict_wait(heater, planned[heater], (int16_t)a);
+			if(secs < 0) break;
+			if(secs > 0) rest_secs += secs + (int32_t)(heater ? heater_model : air_model).dead_time();
+			planned[heater] = pending[heater] = (int16_t)a;
+		}
+	}
+	rest_secs = -1;
 }
 
-static void retarget_menu_temp(uint8_t mode)
+int32_t prog_runner_t::eta_secs()
 {
-	if(mode == MENU_SET_HEATER)
-		heater_set_point = menu_temp;
-	else if(mode == MENU_SET_AIR)
-		air_set_point = menu_temp;
+	if(!running()) return -1;
+	if((int32_t)(millis() - rest_time) >= ETA_REPLAN_MS) plan_rest();
+	if(rest_secs < 0) return -1;
+
+	int32_t cur = 0;
+	if(opcode == PROG_DWELL || opcode == PROG_DWELL_MIN)
+		cur = secs;
+	else if(is_wait_op(opcode))
+		cur = wait_secs();
+	return cur < 0 ? -1 : cur + rest_secs;
 }
 
-static void handle_status_keys(uint8_t mode)
+bool prog_runner_t::start(uint8_t index)
 {
-	set_menu_temp(mode);
-	handle_temp_keys();
-	retarget_menu_temp(mode);
+	if(!open(index)) return false;
+	prog = index;
+	ip = 0;
+	secs = 0;
+	prog_ticks = get_heater_on_ticks();
+	opcode = PROG_END;
+	insn_len = 0;
+	rest_time = millis() - ETA_REPLAN_MS;
+	resuming = false;
+	button_wait = false;
+	watchdog_checkin(WDT_TASK_PROG);
+	restart();
+	return true;
 }
 
+bool prog_runner_t::resume()
+{
+	checkpoint_t cp;
+	if(!checkpoint_load(cp)) return false;
+	if(!open(cp.prog)) return false;
+	prog = cp.prog;
+	ip = cp.ip;
+	secs = cp.secs_remain;
+	heater_set_point = cp.heater_set_point;
+	air_set_point = cp.air_set_point;
+	prog_ticks = get_heater_on_ticks(); // energy before the power loss is not known
+	opcode = PROG_END;
+	insn_len = 0;
+	rest_time = millis() - ETA_REPLAN_MS;
+	resuming = true;
+	button_wait = false;
+	watchdog_checkin(WDT_TASK_PROG);
+	restart();
+	return true;
+}
 
-static uint32_t tone_pattern = 0;
-static bool tone_repeat = false;
-static uint8_t tone_position = 0; 
-static void tone_handler()
+void prog_runner_t::run()
 {
-	EVERY_MS(100)
+	CORO_BEGIN;
+
+	for(;;)
 	{
-		if(tone_pattern & ((uint32_t)1<<tone_position))
+		CORO_YIELD;
+		watchdog_checkin(WDT_TASK_PROG);
+		insn_len = reader.fetch(ip, opcode, arg);
+		if(!resuming)
 		{
-			tone(TONE_PIN, 2000);
+			if(opcode == PROG_DWELL)
+				secs = arg;
+			else if(opcode == PROG_DWELL_MIN)
+				secs = arg * 60;
+			else
+				secs = 0;
 		}
-		else
+
+		if(opcode == PROG_END) break;
+
+		save_checkpoint(true);
+		step_ticks = get_heater_on_ticks();
+		rest_time = millis() - ETA_REPLAN_MS; // replan from this instruction
+
+		if(opcode == PROG_SET_HEATER_TEMP || opcode == PROG_SET_WAIT_HEATER_TEMP)
 		{
-			noTone(TONE_PIN);	
+			heater_set_point = arg;
 		}
-		
-		++ tone_position;
-		if(tone_position >= 32)
+		else if(opcode == PROG_SET_AIR_TEMP || opcode == PROG_SET_WAIT_AIR_TEMP)
 		{
-			if(tone_repeat)
-				tone_position = 0;
-			else
-				tone_position = 0, tone_pattern = 0;
+			air_set_point = arg;
 		}
-			
+
+		if(opcode == PROG_DWELL || opcode == PROG_DWELL_MIN)
+		{
+			deadline = millis();
+			while(secs > 0)
+			{
+				-- secs;
+				save_checkpoint(false);
+				deadline += 1000;
+				CORO_AWAIT_CHECKIN((int32_t)(millis() - deadline) >= 0, WDT_TASK_PROG);
+			}
+		}
+		else if(is_wait_op(opcode))
+		{
+			wait_start = millis();
+			wait_predicted = wait_secs();
+			CORO_AWAIT_CHECKIN(temp_reached(), WDT_TASK_PROG);
+
+			// actual/predicted duration
+			Serial.print(F("W"));
+			Serial.print(ip);
+			Serial.print(':');
+			Serial.print((millis() - wait_start) / 1000);
+			Serial.print('/');
+			Serial.print(wait_predicted);
+			Serial.print(F(" s\r\n"));
+		}
+		else if(opcode == PROG_WAIT_BUTTON)
+		{
+			button_wait = true;
+			CORO_AWAIT_CHECKIN(!button_wait, WDT_TASK_PROG);
+		}
+		else if(opcode == PROG_SET_TONE)
+		{
+			set_tone_pattern(arg, false);
+		}
+		else if(opcode == PROG_SET_TONE_REPEAT)
+		{
+			set_tone_pattern(arg, true);
+		}
+
+		// energy of the instruction
+		Serial.print(F("S"));
+		Serial.print(ip);
+		Serial.print(':');
+		PRINT_REAL(heater_ticks_to_wh(get_heater_on_ticks() - step_ticks));
+		Serial.print(F(" Wh\r\n"));
+
+		resuming = false;
+		ip += insn_len;
 	}
-	END_EVERY_MS
+
+	finish();
+
+	CORO_END;
 }
 
-static void set_tone_pattern(uint32_t pattern, bool repeat)
+static prog_runner_t prog_runner;
+
+// program start requests received over serial
+static uint8_t remote_start_request = CHECKPOINT_NO_PROGRAM;
+static bool ui_at_menu = false; // whether the main menu is waiting for a selection
+
+#define CANCEL_BUTTON_COUNT 2
+#define CANCEL_BUTTON_DURATION 1000
+#define ENERGY_REPORT_MS 60000 // how long the energy of a finished program is shown
+
+static uint8_t ui_hold = HOLD_NONE; // set point to adjust after the menu closes
+
+// menu actions and rows
+static bool menu_start_program(uint8_t prog)
 {
-	tone_pattern = pattern;
-	tone_repeat = repeat;
-	tone_position = 0;
+	prog_runner.start(prog);
+	return true;
 }
 
-// program opecodes
-#define PROG_END    0
-#define PROG_DWELL  1
-#define PROG_SET_HEATER_TEMP 2
-#define PROG_WAIT_HEATER_TEMP 3
-#define PROG_SET_AIR_TEMP 4
-#define PROG_WAIT_AIR_TEMP 5
-#define PROG_WAIT_BUTTON 6
-#define PROG_SET_TONE_REPEAT 7
-#define PROG_SET_TONE 8
+static bool menu_hold(uint8_t mode)
+{
+	ui_hold = mode;
+	return true;
+}
 
-#define MAKE_PROGRAM_WORD(OP, ARG) (((uint32_t)(ARG)<<3) | (OP))
-#define OPCODE_FROM_WORD(CODE) (uint8_t)((CODE)&0x07)
-#define ARG_FROM_WORD(CODE) (uint32_t)((CODE)>>3)
+// EEPROM slot of the i-th stored user program, or PROG_STORE_SLOTS
+static uint8_t user_prog_slot(uint8_t i, char *name)
+{
+	for(uint8_t slot = 0; slot < PROG_STORE_SLOTS; ++slot)
+		if(prog_store_get_name(slot, name) && i-- == 0) return slot;
+	return PROG_STORE_SLOTS;
+}
 
-#define TEMP_MATCH_MARGIN 1.5
+static uint8_t user_prog_count()
+{
+	char name[PROG_STORE_NAME_LEN];
+	uint8_t n = 0;
+	while(user_prog_slot(n, name) != PROG_STORE_SLOTS) ++n;
+	return n;
+}
 
+static_assert(PROG_STORE_NAME_LEN <= MENU_COLS + 1, "program names must fit a menu row");
+static void user_prog_label(uint8_t i, char *buf)
+{
+	if(user_prog_slot(i, buf) == PROG_STORE_SLOTS) buf[0] = 0;
+}
+
+static bool menu_start_user_program(uint8_t i)
+{
+	char name[PROG_STORE_NAME_LEN];
+	uint8_t slot = user_prog_slot(i, name);
+	if(slot == PROG_STORE_SLOTS) return false; // removed over serial meanwhile
+	return menu_start_program(NUM_BUILTIN_PROGRAMS + slot);
+}
+
+static bool menu_save_params(uint8_t)
+{
+	params_commit_requested = true;
+	return false;
+}
 
-static PROGMEM const uint32_t PROG1[] = {
+static bool menu_load_params(uint8_t)
+{
+	params_load();
+	return false;
+}
 
-	MAKE_PROGRAM_WORD(PROG_SET_AIR_TEMP, 117),
-	MAKE_PROGRAM_WORD(PROG_WAIT_AIR_TEMP, 117),
+static bool menu_erase_feed_forward(uint8_t)
+{
+	heater_ff.erase();
+	air_ff.erase();
+	return false;
+}
 
-//	MAKE_PROGRAM_WORD(PROG_SET_TONE_REPEAT,  0b11100011100011100011100000000),
-//	MAKE_PROGRAM_WORD(PROG_WAIT_BUTTON,  0),
-//	MAKE_PROGRAM_WORD(PROG_SET_TONE_REPEAT,  0),
+static bool menu_print_history(uint8_t)
+{
+	history_print();
+	return false;
+}
 
-	MAKE_PROGRAM_WORD(PROG_SET_AIR_TEMP, 160),
-	MAKE_PROGRAM_WORD(PROG_WAIT_AIR_TEMP, 160),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        60*5),
+static void render_ram(char *buf)
+{
+	mem_stats_t s;
+	mem_stats_get(s);
+	sprintf_P(buf, PSTR("free %u min %u\r\nstack max %u"), s.free, s.free_min, s.stack_max);
+}
 
-	MAKE_PROGRAM_WORD(PROG_SET_AIR_TEMP, 73),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        60*60*1),
-	MAKE_PROGRAM_WORD(PROG_SET_AIR_TEMP, 151),
-	MAKE_PROGRAM_WORD(PROG_WAIT_AIR_TEMP, 151),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        60*60*0.9),
-	MAKE_PROGRAM_WORD(PROG_SET_AIR_TEMP, 74),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        60*60*1),
+static void render_resets(char *buf)
+{
+	watchdog_reset_info_t info;
+	watchdog_get_reset_info(info);
+	sprintf_P(buf, PSTR("reset %02x wdt %u\r\nstalled %u"), info.reset_flags, info.wdt_resets, info.last_stalled_task);
+}
 
-	MAKE_PROGRAM_WORD(PROG_SET_AIR_TEMP, 152),
-	MAKE_PROGRAM_WORD(PROG_WAIT_AIR_TEMP, 152),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        60*60*0.7),
-	MAKE_PROGRAM_WORD(PROG_SET_AIR_TEMP, 75),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        60*60*1),
+static void render_model(char *buf)
+{
+	sprintf_P(buf, PSTR("H %4ds %4dC\r\nA %4ds %4dC"),
+		(int)heater_model.tau(), (int)heater_model.gain(), (int)air_model.tau(), (int)air_model.gain());
+}
 
-	MAKE_PROGRAM_WORD(PROG_SET_TONE_REPEAT,  0b1111111111111000000000000000),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        5),
-	MAKE_PROGRAM_WORD(PROG_SET_TONE_REPEAT,  0),
-	MAKE_PROGRAM_WORD(PROG_END,          0)
+// menu tree; labels, editors and rows all stay in flash
+#define MENU_LABEL(name, text) static const char name[] PROGMEM = text
+#define MENU_ITEMS(items) (uint8_t)(sizeof(items) / sizeof(items[0])), items
+
+MENU_LABEL(LABEL_PROG1, "Start Yakiimo");
+MENU_LABEL(LABEL_PROG2, "Test Program");
+MENU_LABEL(LABEL_SET_HEATER, "Set heater temp");
+MENU_LABEL(LABEL_SET_AIR, "Set air temp");
+MENU_LABEL(LABEL_USER_PROGS, "User programs");
+MENU_LABEL(LABEL_TUNING, "Tuning");
+MENU_LABEL(LABEL_HEATER_KP, "Heater Kp");
+MENU_LABEL(LABEL_HEATER_KI, "Heater Ki");
+MENU_LABEL(LABEL_HEATER_KD, "Heater Kd");
+MENU_LABEL(LABEL_AIR_KP, "Air Kp");
+MENU_LABEL(LABEL_AIR_KI, "Air Ki");
+MENU_LABEL(LABEL_AIR_KD, "Air Kd");
+MENU_LABEL(LABEL_FF_GAIN, "Feed-fwd gain");
+MENU_LABEL(LABEL_HISTORY_INTERVAL, "History int. s");
+MENU_LABEL(LABEL_SAVE, "Save");
+MENU_LABEL(LABEL_LOAD, "Revert");
+MENU_LABEL(LABEL_DIAG, "Diagnostics");
+MENU_LABEL(LABEL_RAM, "RAM");
+MENU_LABEL(LABEL_RESETS, "Resets");
+MENU_LABEL(LABEL_MODEL, "Model");
+MENU_LABEL(LABEL_ERASE_FF, "Forget feed-fwd");
+MENU_LABEL(LABEL_HISTORY, "History>serial");
+
+static const menu_editor_t EDIT_HEATER_SET_POINT PROGMEM = { PARAM_HEATER_SET_POINT, 0, 1 };
+static const menu_editor_t EDIT_AIR_SET_POINT PROGMEM = { PARAM_AIR_SET_POINT, 0, 1 };
+static const menu_editor_t EDIT_HEATER_KP PROGMEM = { PARAM_HEATER_KP, 1, 0.5 };
+static const menu_editor_t EDIT_HEATER_KI PROGMEM = { PARAM_HEATER_KI, 2, 0.05 };
+static const menu_editor_t EDIT_HEATER_KD PROGMEM = { PARAM_HEATER_KD, 0, 50 };
+static const menu_editor_t EDIT_AIR_KP PROGMEM = { PARAM_AIR_KP, 1, 0.5 };
+static const menu_editor_t EDIT_AIR_KI PROGMEM = { PARAM_AIR_KI, 2, 0.05 };
+static const menu_editor_t EDIT_AIR_KD PROGMEM = { PARAM_AIR_KD, 0, 50 };
+static const menu_editor_t EDIT_FF_GAIN PROGMEM = { PARAM_FEED_FORWARD_GAIN, 2, 0.05 };
+static const menu_editor_t EDIT_HISTORY_INTERVAL PROGMEM = { PARAM_HISTORY_INTERVAL, 0, 10 };
+
+static const menu_list_t USER_PROGS PROGMEM = { user_prog_count, user_prog_label };
+static const menu_view_t VIEW_RAM PROGMEM = { render_ram };
+static const menu_view_t VIEW_RESETS PROGMEM = { render_resets };
+static const menu_view_t VIEW_MODEL PROGMEM = { render_model };
+
+static const menu_item_t TUNING_MENU[] PROGMEM =
+{
+	{ LABEL_HEATER_KP, MENU_EDIT, 0, &EDIT_HEATER_KP, nullptr },
+	{ LABEL_HEATER_KI, MENU_EDIT, 0, &EDIT_HEATER_KI, nullptr },
+	{ LABEL_HEATER_KD, MENU_EDIT, 0, &EDIT_HEATER_KD, nullptr },
+	{ LABEL_AIR_KP, MENU_EDIT, 0, &EDIT_AIR_KP, nullptr },
+	{ LABEL_AIR_KI, MENU_EDIT, 0, &EDIT_AIR_KI, nullptr },
+	{ LABEL_AIR_KD, MENU_EDIT, 0, &EDIT_AIR_KD, nullptr },
+	{ LABEL_FF_GAIN, MENU_EDIT, 0, &EDIT_FF_GAIN, nullptr },
+	{ LABEL_HISTORY_INTERVAL, MENU_EDIT, 0, &EDIT_HISTORY_INTERVAL, nullptr },
+	{ LABEL_SAVE, MENU_ACTION, 0, nullptr, menu_save_params },
+	{ LABEL_LOAD, MENU_ACTION, 0, nullptr, menu_load_params },
 };
-static PROGMEM const uint32_t PROG2[] = {
-	MAKE_PROGRAM_WORD(PROG_SET_AIR_TEMP, 73),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        60*60*2),
-	MAKE_PROGRAM_WORD(PROG_SET_AIR_TEMP, 151),
-	MAKE_PROGRAM_WORD(PROG_WAIT_AIR_TEMP, 151),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        60*60*0.9),
-	MAKE_PROGRAM_WORD(PROG_SET_AIR_TEMP, 74),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        60*60*2),
-
-	MAKE_PROGRAM_WORD(PROG_SET_AIR_TEMP, 152),
-	MAKE_PROGRAM_WORD(PROG_WAIT_AIR_TEMP, 152),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        60*60*0.8),
-	MAKE_PROGRAM_WORD(PROG_SET_AIR_TEMP, 75),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        60*60*2),
-
-	MAKE_PROGRAM_WORD(PROG_SET_TONE_REPEAT,  0b1111111111111000000000000000),
-	MAKE_PROGRAM_WORD(PROG_DWELL,        5),
-	MAKE_PROGRAM_WORD(PROG_SET_TONE_REPEAT,  0),
-	MAKE_PROGRAM_WORD(PROG_END,          0)
+
+static const menu_item_t DIAG_MENU[] PROGMEM =
+{
+	{ LABEL_RAM, MENU_VIEW, 0, &VIEW_RAM, nullptr },
+	{ LABEL_RESETS, MENU_VIEW, 0, &VIEW_RESETS, nullptr },
+	{ LABEL_MODEL, MENU_VIEW, 0, &VIEW_MODEL, nullptr },
+	{ LABEL_ERASE_FF, MENU_ACTION, 0, nullptr, menu_erase_feed_forward },
+	{ LABEL_HISTORY, MENU_ACTION, 0, nullptr, menu_print_history },
 };
 
-#define CANCEL_BUTTON_COUNT 2
-#define CANCEL_BUTTON_DURATION 1000
+static const menu_item_t MAIN_MENU[] PROGMEM =
+{
+	{ LABEL_PROG1, MENU_ACTION, 0, nullptr, menu_start_program },
+	{ LABEL_PROG2, MENU_ACTION, 1, nullptr, menu_start_program },
+	{ LABEL_SET_HEATER, MENU_EDIT, HOLD_HEATER, &EDIT_HEATER_SET_POINT, menu_hold },
+	{ LABEL_SET_AIR, MENU_EDIT, HOLD_AIR, &EDIT_AIR_SET_POINT, menu_hold },
+	{ LABEL_USER_PROGS, MENU_LIST, 0, &USER_PROGS, menu_start_user_program },
+	{ LABEL_TUNING, MENU_SUBMENU, MENU_ITEMS(TUNING_MENU), nullptr },
+	{ LABEL_DIAG, MENU_SUBMENU, MENU_ITEMS(DIAG_MENU), nullptr },
+};
 
-static bool handle_prog_keys()
+static_assert(MENU_LINES == LCD_LINES && MENU_COLS == LCD_COLS, "menu must match the display");
+
+static void handle_menu_keys()
+{
+	int8_t steps = (int8_t)(button_counts[BUTTON_DOWN] - button_counts[BUTTON_UP]);
+	bool ok = button_counts[BUTTON_OK] != 0;
+	button_counts[BUTTON_UP] = button_counts[BUTTON_DOWN] = button_counts[BUTTON_OK] = 0;
+	menu_handle_keys(steps, ok);
+
+	char buf[MENU_RENDER_SIZE];
+	menu_render(buf);
+	if(menu_is_open()) display(buf);
+}
+
+// user interface
+class ui_task_t : public coro_t
+{
+	uint32_t last_button_pressed; //!< for double-press cancel
+	uint8_t button_pressed_count;
+	bool prog_was_running; //!< a program ran since the menu was last shown
+	uint32_t report_until; //!< end of the energy report display
+
+	bool handle_prog_keys();
+	bool handle_wait_button_keys();
+
+public:
+	ui_task_t() : last_button_pressed(0), button_pressed_count(0), prog_was_running(false), report_until(0) {}
+
+	void run() override;
+};
+
+// program ETA for the status line; h:mm, or m'ss under an hour
+static String format_eta(int32_t secs)
+{
+	char buf[8];
+	if(secs >= 3600)
+		sprintf_P(buf, PSTR("%ld:%02ld"), (long)(secs / 3600), (long)(secs / 60 % 60));
+	else
+		sprintf_P(buf, PSTR("%ld'%02ld"), (long)(secs / 60), (long)(secs % 60));
+	return String(buf);
+}
+
+bool ui_task_t::handle_prog_keys()
 {
-	static uint32_t last_button_pressed;
-	static uint8_t button_pressed_count;
 	if(button_counts[BUTTON_OK] != 0)
 	{
 		button_counts[BUTTON_OK] = 0;
@@ -735,8 +1509,11 @@ static bool handle_prog_keys()
 	}
 
 
-	if(secs_remain != 0)
-		update_status_display(String(secs_remain));
+	int32_t eta = prog_runner.eta_secs();
+	if(eta >= 0)
+		update_status_display(format_eta(eta));
+	else if(prog_runner.secs_remain() != 0)
+		update_status_display(String(prog_runner.secs_remain()));
 	else
 		update_status_display(String(F("Busy")));
 
@@ -744,7 +1521,7 @@ static bool handle_prog_keys()
 }
 
 
-static bool handle_wait_button_keys()
+bool ui_task_t::handle_wait_button_keys()
 {
 	if(button_counts[BUTTON_OK] != 0)
 	{
@@ -757,169 +1534,292 @@ static bool handle_wait_button_keys()
 	return true;
 }
 
-static void ui_handler()
+void ui_task_t::run()
 {
-	static uint8_t state = 0;
-	switch(state)
+	CORO_BEGIN;
+
+	// wait for the first temperature conversion, then resume the program
+	// interrupted by power loss if the oven is still hot
+	CORO_AWAIT_CHECKIN(temps_valid, WDT_TASK_UI);
+	if(any_hot && prog_runner.resume())
+		display(F("Resuming\r\nprogram"));
+	else
+		checkpoint_clear();
+
+	for(;;)
 	{
-	default:
-		YIELD;
+		// follow the running program until it ends or is cancelled
+		while(prog_runner.running())
+		{
+			prog_was_running = true;
+			if(prog_runner.waiting_for_button())
+			{
+				if(!handle_wait_button_keys()) prog_runner.button_pressed();
+			}
+			else if(!handle_prog_keys())
+			{
+				prog_runner.stop();
+			}
+			watchdog_checkin(WDT_TASK_UI);
+			CORO_YIELD;
+		}
 
-		for(;;)
+		// report the energy of the program just ended until OK or timeout
+		if(prog_was_running)
 		{
-			// first, show main screen
-start:
-			init_temps();
-			init_menu();
-			add_menu(F("Start Yakiimo")); // MENU_PROG1
-			add_menu(F("Test Program")); // MENU_PROG2
-			add_menu(F("Set heater temp")); // MENU_SET_HEATER
-			add_menu(F("Set air temp")); // MENU_SET_AIR
+			prog_was_running = false;
+			char wh[REAL_FORMAT_SIZE];
+			display(String(F("Finished\r\n")) + FORMAT_REAL(prog_runner.energy_wh(), 1, wh) + F(" Wh"));
+			button_counts[BUTTON_OK] = 0;
+			report_until = millis() + ENERGY_REPORT_MS;
+			CORO_AWAIT_CHECKIN(button_counts[BUTTON_OK] != 0 || (int32_t)(millis() - report_until) >= 0, WDT_TASK_UI);
+			button_counts[BUTTON_OK] = 0;
+		}
 
-			show_menus();
-			YIELD;
+		// show main screen
+		init_temps();
+		init_buttons();
+		ui_hold = HOLD_NONE;
+		menu_open(MAIN_MENU, sizeof(MAIN_MENU) / sizeof(MAIN_MENU[0]));
 
+		ui_at_menu = true;
+		while(menu_is_open() && remote_start_request == CHECKPOINT_NO_PROGRAM)
+		{
+			handle_menu_keys();
+			watchdog_checkin(WDT_TASK_UI);
+			CORO_YIELD;
+		}
+		ui_at_menu = false;
+
+		if(remote_start_request != CHECKPOINT_NO_PROGRAM)
+		{
+			menu_close();
+			prog_runner.start(remote_start_request);
+			remote_start_request = CHECKPOINT_NO_PROGRAM;
+			continue;
+		}
+
+		// adjust the set point just entered until OK
+		if(ui_hold != HOLD_NONE)
+		{
 			while(button_counts[BUTTON_OK] == 0)
 			{
-				menu_handle_keys();
-				show_menus();
-				YIELD;
+				handle_status_keys(ui_hold);
+				update_status_display(String());
+				watchdog_checkin(WDT_TASK_UI);
+				CORO_YIELD;
 			}
 			button_counts[BUTTON_OK] = 0;
-			static uint8_t m_ind;
-			m_ind = menu_selected_index;
-
-			if(m_ind == MENU_PROG1 || m_ind == MENU_PROG2)
-			{
-				static const uint32_t *prog = nullptr;
-				if(m_ind == MENU_PROG1)
-					prog = PROG1;
-				else if(m_ind == MENU_PROG2)
-					prog = PROG2;
+		}
+	}
 
-				for(;;)
-				{
-					YIELD;
-					static uint32_t current_op;
-					current_op = pgm_read_dword(prog);
-					static uint8_t opcode;
-					opcode = OPCODE_FROM_WORD(current_op);
-					secs_remain = 0;
-
-					if(opcode == PROG_END)
-					{
-						goto start;
-					}
-					else if(opcode == PROG_DWELL)
-					{
-						secs_remain = ARG_FROM_WORD(current_op);
-						while(secs_remain --)
-						{
-							YIELD;
-							static uint32_t m;
-							m = millis() + 1000;
-
-							while((int32_t)(millis() - m) <= 0)
-							{
-								YIELD;
-								if(!handle_prog_keys()) goto start;
-							}
-						}
-					}
-					else if(opcode == PROG_SET_HEATER_TEMP)
-					{
-						heater_set_point = ARG_FROM_WORD(current_op);
-					}
-					else if(opcode == PROG_SET_AIR_TEMP)
-					{
-						air_set_point = ARG_FROM_WORD(current_op);
-					}
-					else if(opcode == PROG_WAIT_HEATER_TEMP || opcode == PROG_WAIT_AIR_TEMP)
-					{
-						static int16_t temp;
-						temp = ARG_FROM_WORD(current_op);
-						for(;;)
-						{
-							YIELD;
-							if(opcode == PROG_WAIT_HEATER_TEMP)
-							{
-								if(heater_temp - TEMP_MATCH_MARGIN <= temp && temp <= heater_temp + TEMP_MATCH_MARGIN ) break;
-							}
-							else if(opcode == PROG_WAIT_AIR_TEMP)
-							{
-								if(air_temp - TEMP_MATCH_MARGIN <= temp && temp <= air_temp + TEMP_MATCH_MARGIN ) break;
-							}
-							
-							if(!handle_prog_keys()) goto start;
-						}
-					}
-					else if(opcode == PROG_WAIT_BUTTON)
-					{
-						for(;;)
-						{
-							YIELD;
-							if(!handle_wait_button_keys()) break;
-						}
-					}
-					else if(opcode == PROG_SET_TONE)
-					{
-						set_tone_pattern(ARG_FROM_WORD(current_op), false);
-					}
-					else if(opcode == PROG_SET_TONE_REPEAT)
-					{
-						set_tone_pattern(ARG_FROM_WORD(current_op), true);
-					}
-
-					++ prog;
-				}
+	CORO_END;
+}
 
-				goto start;
-			}
-			else if(m_ind == MENU_SET_HEATER || m_ind == MENU_SET_AIR)
-			{
-				// set heater/air temp
-				init_set_temp();
+static ui_task_t ui_task;
+static coro_executor_t<2> tasks(&ui_task, &prog_runner);
 
-				set_menu_temp(m_ind);
+// handle a binary serial command
+void serial_proto_dispatch(uint8_t cmd, const uint8_t *args, uint8_t len)
+{
+	switch(cmd)
+	{
+	case CMD_GET_STATUS:
+	{
+		status_reply_t st;
+		st.heater_set_point = heater_set_point;
+		st.heater_temp = heater_temp;
+		st.air_set_point = air_set_point;
+		st.air_temp = air_temp;
+		st.env_temp = env_temp;
+		st.heater_power = heater_power;
+		st.prog = prog_runner.program();
+		st.prog_ip = prog_runner.position();
+		st.secs_remain = prog_runner.running() ? prog_runner.secs_remain() : 0;
+		st.energy_wh = prog_runner.energy_wh();
+		st.eta_secs = prog_runner.eta_secs();
+		serial_proto_reply(cmd, STATUS_OK, &st, sizeof(st));
+		return;
+	}
 
-				while(button_counts[BUTTON_OK] == 0)
-				{
-					handle_temp_keys();
-					if(m_ind == MENU_SET_HEATER)
-						show_temps(F("Heater temp:"));
-					else if(m_ind == MENU_SET_AIR)
-						show_temps(F("Air temp:"));
-					YIELD;
-				}
-				button_counts[BUTTON_OK] = 0;
+	case CMD_SET_PARAMS:
+		if(len == 0 || len % 5 != 0)
+			break;
+		if(num_pending_params != 0)
+		{
+			// previous batch not applied yet
+			serial_proto_reply(cmd, STATUS_BUSY, nullptr, 0);
+			return;
+		}
+		for(uint8_t i = 0; i < len; i += 5)
+		{
+			float v;
+			memcpy(&v, args + i + 1, sizeof(float));
+			if(!param_valid(args[i], v)) break;
+			pending_param_ids[num_pending_params] = args[i];
+			pending_param_values[num_pending_params] = v;
+			++ num_pending_params;
+		}
+		// each limit is only range-checked on its own; the pair must stay ordered
+		if(num_pending_params * 5 != len
+			|| pending_param_value(PARAM_HEATER_LOW_LIMIT) > pending_param_value(PARAM_HEATER_HIGH_LIMIT)
+			|| pending_param_value(PARAM_AIR_LOW_LIMIT) > pending_param_value(PARAM_AIR_HIGH_LIMIT))
+		{
+			num_pending_params = 0; // reject the whole batch
+			break;
+		}
+		serial_proto_reply(cmd, STATUS_OK, nullptr, 0);
+		return;
 
-				retarget_menu_temp(m_ind);
+	case CMD_GET_PARAMS:
+	{
+		float values[SERIAL_PROTO_MAX_PAYLOAD / sizeof(float)];
+		if(len == 0 || len > sizeof(values) / sizeof(values[0])) break;
+		uint8_t i;
+		for(i = 0; i < len && args[i] < NUM_PARAMS; ++i)
+			values[i] = *param_ptr(args[i]);
+		if(i != len) break;
+		serial_proto_reply(cmd, STATUS_OK, values, len * sizeof(float));
+		return;
+	}
 
-				while(button_counts[BUTTON_OK] == 0)
-				{
-					handle_status_keys(m_ind);
-					update_status_display(String());
-					YIELD;
-				}
-				button_counts[BUTTON_OK] = 0;
-			}
+	case CMD_START_PROGRAM:
+		if(len != 1 || args[0] >= NUM_PROGRAMS) break;
+		if(!ui_at_menu || remote_start_request != CHECKPOINT_NO_PROGRAM)
+		{
+			serial_proto_reply(cmd, STATUS_BUSY, nullptr, 0);
+			return;
+		}
+		if(args[0] >= NUM_BUILTIN_PROGRAMS)
+		{
+			char name[PROG_STORE_NAME_LEN];
+			if(!prog_store_get_name(args[0] - NUM_BUILTIN_PROGRAMS, name)) break;
+		}
+		remote_start_request = args[0];
+		serial_proto_reply(cmd, STATUS_OK, nullptr, 0);
+		return;
+
+	case CMD_STOP_PROGRAM:
+		if(len != 0) break;
+		prog_runner.stop();
+		serial_proto_reply(cmd, STATUS_OK, nullptr, 0);
+		return;
+
+	case CMD_COMMIT_PARAMS:
+	case CMD_LOAD_PARAMS:
+	case CMD_ERASE_PARAMS:
+		if(len != 0) break;
+		if(num_pending_params != 0)
+		{
+			// let the staged batch take effect first
+			serial_proto_reply(cmd, STATUS_BUSY, nullptr, 0);
+			return;
 		}
+		if(cmd == CMD_COMMIT_PARAMS)
+			params_commit_requested = true; // written at the end of this loop() pass
+		else if(cmd == CMD_ERASE_PARAMS)
+			params_erase();
+		else if(!params_load())
+			break;
+		serial_proto_reply(cmd, STATUS_OK, nullptr, 0);
+		return;
+
+	case CMD_ERASE_FEED_FORWARD:
+		if(len != 0) break;
+		heater_ff.erase();
+		air_ff.erase();
+		serial_proto_reply(cmd, STATUS_OK, nullptr, 0);
+		return;
 
-		YIELD;
-		state = 0;
+	case CMD_GET_RESET_INFO:
+	{
+		if(len != 0) break;
+		watchdog_reset_info_t info;
+		watchdog_get_reset_info(info);
+		serial_proto_reply(cmd, STATUS_OK, &info, sizeof(info));
+		return;
 	}
+
+	case CMD_GET_MEM_STATS:
+	{
+		if(len != 0) break;
+		mem_stats_t s;
+		mem_stats_get(s);
+		serial_proto_reply(cmd, STATUS_OK, &s, sizeof(s));
+		return;
+	}
+
+	case CMD_ARM_CAPTURE:
+		if(len != 3) break;
+		capture_arm(args[0], args[1], args[2]);
+		serial_proto_reply(cmd, STATUS_OK, nullptr, 0);
+		return;
+
+	case CMD_TRIGGER_CAPTURE:
+		if(len != 0) break;
+		capture_trigger(CAPTURE_TRIG_MANUAL);
+		serial_proto_reply(cmd, STATUS_OK, nullptr, 0);
+		return;
+
+	case CMD_GET_CAPTURE:
+	{
+		if(len != 2) break;
+		uint8_t reply[2 + SERIAL_PROTO_DUMP_CHUNK];
+		uint16_t total = capture_dump_length();
+		reply[0] = total & 0xff;
+		reply[1] = total >> 8;
+		uint8_t n = capture_dump(args[0] | (args[1] << 8), reply + 2, SERIAL_PROTO_DUMP_CHUNK);
+		serial_proto_reply(cmd, STATUS_OK, reply, 2 + n);
+		return;
+	}
+
+	case CMD_GET_HISTORY:
+	{
+		if(len != 2) break;
+		uint8_t reply[2 + SERIAL_PROTO_DUMP_CHUNK];
+		uint16_t total = history_dump_length();
+		reply[0] = total & 0xff;
+		reply[1] = total >> 8;
+		uint8_t n = history_dump(args[0] | (args[1] << 8), reply + 2, SERIAL_PROTO_DUMP_CHUNK);
+		serial_proto_reply(cmd, STATUS_OK, reply, 2 + n);
+		return;
+	}
+
+	default:
+		serial_proto_reply(cmd, STATUS_BAD_COMMAND, nullptr, 0);
+		return;
+	}
+
+	serial_proto_reply(cmd, STATUS_BAD_ARGUMENT, nullptr, 0);
 }
 
 void setup() {
 	// put your setup code here, to run once:
+	params_load();
+	heater_ff.load();
+	air_ff.load();
+	history_init();
+	capture_arm(CAPTURE_TRIG_ALL, CAPTURE_SAMPLES / 2, 1);
 	init_buttons();
 	Serial.begin(115200);
 	pinMode(HEATER_PIN, OUTPUT);
 	lcd.begin(LCD_COLS, LCD_LINES);
-	Timer1.initialize(1000000 / 110);
+	Timer1.initialize(1000000 / PWM_FREQ);
 	Timer1.attachInterrupt(timer1_handler);
 
 	display(F("welcome\r\nyakiimo"));
+
+	watchdog_init();
+	watchdog_idle(WDT_TASK_PROG); // until a program starts
+	watchdog_reset_info_t info;
+	watchdog_get_reset_info(info);
+	Serial.print(F("reset:"));
+	Serial.print(info.reset_flags, HEX);
+	Serial.print(F(" wdt:"));
+	Serial.print((int)info.wdt_resets);
+	Serial.print(F(" stalled:"));
+	Serial.print((int)info.last_stalled_task);
+	Serial.print(F("\r\n"));
 }
 
 void loop() {
@@ -928,12 +1828,21 @@ void loop() {
 	button_update_handler();
 	tone_handler();
 	EVERY_MS(20)
-		ui_handler();
+		tasks.run(); // the coroutines check themselves in
+	END_EVERY_MS
+	EVERY_MS(HISTORY_FLUSH_MS)
+		history_flush_requested = true;
 	END_EVERY_MS
+	history_print_poll();
+	if(capture_print_poll())
+		capture_arm(CAPTURE_TRIG_ALL, CAPTURE_SAMPLES / 2, 1);
 
 	while(Serial.available() > 0)
 	{
-		switch(Serial.read())
+		int c = Serial.read();
+		if(serial_proto_feed(c)) continue;
+		if(prog_upload_feed(c)) continue;
+		switch(c)
 		{
 		case '8':
 			if(button_counts[BUTTON_UP] < 255) ++button_counts[BUTTON_UP];
@@ -944,9 +1853,34 @@ void loop() {
 		case '5':
 			if(button_counts[BUTTON_OK] < 255) ++button_counts[BUTTON_OK];
 			break;
+		case 'h':
+			history_print();
+			break;
+		case 'c':
+			capture_print(); // re-armed when printed
+			break;
+		case 't':
+			capture_trigger(CAPTURE_TRIG_MANUAL);
+			break;
+		case 'm':
+			mem_stats_print();
+			break;
 		default:;
 		}
 	}
 
+	// one slow EEPROM write per pass keeps the loop within WDT_MAX_BLOCKING_MS
+	if(params_commit_requested)
+	{
+		params_commit_requested = false;
+		params_commit();
+	}
+	else if(history_flush_requested)
+	{
+		history_flush_requested = false;
+		history_flush();
+	}
+
+	watchdog_poll();
 
 }
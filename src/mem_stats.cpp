@@ -0,0 +1,82 @@
+#include <Arduino.h>
+#include <stdlib.h>
+#include "mem_stats.h"
+
+extern uint8_t __heap_start; // end of .noinit; where the heap starts
+extern char *__brkval; // heap break, or 0 before the first malloc()
+extern size_t __malloc_margin; // malloc() keeps this far below the stack
+
+// avr-libc malloc free list
+struct __freelist
+{
+	size_t sz; //!< size of the block after this field
+	struct __freelist *nx;
+};
+extern struct __freelist *__flp;
+
+static uint8_t *heap_top()
+{
+	return __brkval ? (uint8_t *)__brkval : &__heap_start;
+}
+
+/**
+ * Paint the free RAM. Runs after .data/.bss are initialised and before
+ * the constructors, so nothing lives above the heap start yet.
+ * */
+void mem_stats_paint() __attribute__((naked, used, section(".init5")));
+void mem_stats_paint()
+{
+	for(uint8_t *p = &__heap_start; p < (uint8_t *)(uintptr_t)SP; ++p) *p = MEM_PAINT;
+}
+
+void mem_stats_get(mem_stats_t &s)
+{
+	uint8_t *top = heap_top();
+	uint8_t *sp = (uint8_t *)(uintptr_t)SP;
+
+	// the heap may have grown over paint since boot; start from its break
+	uint8_t *low = top;
+	while(low < sp && *low == MEM_PAINT) ++low;
+
+	uint16_t heap_free = 0;
+	uint16_t largest = 0;
+	for(struct __freelist *f = __flp; f; f = f->nx)
+	{
+		heap_free += f->sz;
+		if(f->sz > largest) largest = f->sz;
+	}
+	uint16_t gap = sp - top;
+	if(gap > __malloc_margin && gap - __malloc_margin > largest) largest = gap - __malloc_margin;
+
+	s.static_size = &__heap_start - (uint8_t *)(uintptr_t)RAMSTART;
+	s.heap_size = top - &__heap_start;
+	s.heap_free = heap_free;
+	s.stack_size = RAMEND - (uintptr_t)sp;
+	s.stack_max = RAMEND + 1 - (uintptr_t)low;
+	s.free = gap;
+	s.free_min = low - top;
+	s.largest_free = largest;
+}
+
+void mem_stats_print()
+{
+	mem_stats_t s;
+	mem_stats_get(s);
+	Serial.print(F("ram: static "));
+	Serial.print(s.static_size);
+	Serial.print(F(" heap "));
+	Serial.print(s.heap_size);
+	Serial.print(F(" (free "));
+	Serial.print(s.heap_free);
+	Serial.print(F(") stack "));
+	Serial.print(s.stack_size);
+	Serial.print(F(" max "));
+	Serial.print(s.stack_max);
+	Serial.print(F(" free "));
+	Serial.print(s.free);
+	Serial.print(F(" min "));
+	Serial.print(s.free_min);
+	Serial.print(F(" largest "));
+	Serial.print(s.largest_free);
+	Serial.print(F("\r\n"));
+}
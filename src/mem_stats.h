@@ -0,0 +1,46 @@
+#ifndef MEM_STATS_H__
+#define MEM_STATS_H__
+
+#include <stdint.h>
+
+/*
+	RAM footprint instrumentation.
+
+	At startup the free RAM between the top of .bss/.noinit and the stack
+	pointer is painted with MEM_PAINT. The stack high-water mark is where the
+	paint is first found intact above the heap, so it covers every interrupt
+	and call depth reached since boot. The heap figures walk the avr-libc
+	malloc free list, which String relies on.
+
+	For the static footprint per symbol see the RAM report printed by
+	extra_script.py after each firmware link.
+*/
+
+#define MEM_PAINT 0xc5
+
+/**
+ * RAM usage snapshot; also the CMD_GET_MEM_STATS reply data. Bytes.
+ * */
+struct __attribute__((packed)) mem_stats_t
+{
+	uint16_t static_size; //!< .data + .bss + .noinit
+	uint16_t heap_size; //!< heap from its start to the break, free blocks included
+	uint16_t heap_free; //!< free list blocks below the break
+	uint16_t stack_size; //!< current stack depth
+	uint16_t stack_max; //!< deepest stack since boot
+	uint16_t free; //!< between the break and the stack pointer now
+	uint16_t free_min; //!< between the break and the deepest stack since boot
+	uint16_t largest_free; //!< largest block malloc() can return now
+};
+
+/**
+ * take a snapshot
+ * */
+void mem_stats_get(mem_stats_t &s);
+
+/**
+ * print a snapshot to serial
+ * */
+void mem_stats_print();
+
+#endif
@@ -0,0 +1,257 @@
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include <stdlib.h>
+#include <string.h>
+#include "menu.h"
+#include "params.h"
+#include "thermistor_fx.h"
+
+struct menu_level_t
+{
+	const menu_item_t *owner; //!< PROGMEM item that opened this level; nullptr for the root
+	const menu_item_t *items; //!< PROGMEM rows of a submenu; nullptr for a list
+	uint8_t count; //!< rows, excluding Back
+	uint8_t selected;
+	uint8_t first; //!< first row shown
+};
+
+enum menu_mode_t : uint8_t
+{
+	MODE_CLOSED,
+	MODE_NAVIGATE,
+	MODE_EDIT,
+	MODE_VIEW,
+};
+
+static menu_level_t levels[MENU_MAX_DEPTH + 1];
+static uint8_t depth; // index of the current level; 0 is the root
+static menu_mode_t mode = MODE_CLOSED;
+static const menu_item_t *active; // PROGMEM item being edited or viewed
+static float edit_value;
+
+static void read_item(const menu_item_t *p, menu_item_t &it)
+{
+	memcpy_P(&it, p, sizeof(it));
+}
+
+// rows of the current level, including Back below the root
+static uint8_t rows()
+{
+	return levels[depth].count + (depth ? 1 : 0);
+}
+
+// keep the selected row on screen
+static void scroll(menu_level_t &l)
+{
+	if(l.selected < l.first)
+		l.first = l.selected;
+	else if(l.selected >= l.first + MENU_LINES)
+		l.first = l.selected - MENU_LINES + 1;
+}
+
+static void enter(const menu_item_t *owner, const menu_item_t *items, uint8_t count)
+{
+	if(depth == MENU_MAX_DEPTH) return;
+	menu_level_t &l = levels[++depth];
+	l.owner = owner;
+	l.items = items;
+	l.count = count;
+	l.selected = 0;
+	l.first = 0;
+}
+
+void menu_open(const menu_item_t *items, uint8_t count)
+{
+	depth = 0;
+	levels[0].owner = nullptr;
+	levels[0].items = items;
+	levels[0].count = count;
+	levels[0].selected = 0;
+	levels[0].first = 0;
+	mode = MODE_NAVIGATE;
+}
+
+bool menu_is_open()
+{
+	return mode != MODE_CLOSED;
+}
+
+void menu_close()
+{
+	mode = MODE_CLOSED;
+}
+
+static void run_action(menu_action_t action, uint8_t arg)
+{
+	if(action && action(arg)) menu_close();
+}
+
+static void select(const menu_item_t *p)
+{
+	menu_item_t it;
+	read_item(p, it);
+	switch(it.kind)
+	{
+	case MENU_SUBMENU:
+		enter(p, (const menu_item_t *)it.data, it.arg);
+		break;
+
+	case MENU_LIST:
+	{
+		menu_list_t list;
+		memcpy_P(&list, it.data, sizeof(list));
+		enter(p, nullptr, list.count());
+		break;
+	}
+
+	case MENU_ACTION:
+		run_action(it.action, it.arg);
+		break;
+
+	case MENU_EDIT:
+	{
+		menu_editor_t ed;
+		memcpy_P(&ed, it.data, sizeof(ed));
+		edit_value = *param_ptr(ed.param);
+		active = p;
+		mode = MODE_EDIT;
+		break;
+	}
+
+	case MENU_VIEW:
+		active = p;
+		mode = MODE_VIEW;
+		break;
+	}
+}
+
+static void navigate(int8_t steps, bool ok)
+{
+	menu_level_t &l = levels[depth];
+	int16_t s = (int16_t)l.selected + steps;
+	if(s >= rows()) s = rows() - 1;
+	if(s < 0) s = 0;
+	l.selected = s;
+	scroll(l);
+	if(!ok) return;
+
+	if(l.selected == l.count)
+	{
+		// Back
+		--depth;
+	}
+	else if(!l.items)
+	{
+		menu_item_t owner;
+		read_item(l.owner, owner);
+		run_action(owner.action, l.selected);
+	}
+	else
+	{
+		select(l.items + l.selected);
+	}
+}
+
+static void edit(int8_t steps, bool ok)
+{
+	menu_item_t it;
+	menu_editor_t ed;
+	read_item(active, it);
+	memcpy_P(&ed, it.data, sizeof(ed));
+
+	param_limits_t l = param_limits(ed.param);
+	edit_value += steps * ed.step;
+	if(edit_value > l.high) edit_value = l.high;
+	if(edit_value < l.low) edit_value = l.low;
+	if(!ok) return;
+
+	*param_ptr(ed.param) = edit_value;
+	mode = MODE_NAVIGATE;
+	run_action(it.action, it.arg);
+}
+
+void menu_handle_keys(int8_t steps, bool ok)
+{
+	switch(mode)
+	{
+	case MODE_NAVIGATE:
+		navigate(steps, ok);
+		break;
+	case MODE_EDIT:
+		edit(steps, ok);
+		break;
+	case MODE_VIEW:
+		if(ok) mode = MODE_NAVIGATE;
+		break;
+	default:;
+	}
+}
+
+// append one display row; text is truncated to the display width
+static char *put_row(char *p, char cursor, const char *text, bool pgm)
+{
+	uint8_t n = 0;
+	if(cursor) *p++ = cursor, ++n;
+	for(char c; n < MENU_COLS && (c = pgm ? pgm_read_byte(text) : *text); ++text, ++n) *p++ = c;
+	*p++ = '\r';
+	*p++ = '\n';
+	return p;
+}
+
+void menu_render(char *buf)
+{
+	char *p = buf;
+	menu_item_t it;
+
+	if(mode == MODE_EDIT)
+	{
+		char value[REAL_FORMAT_SIZE];
+		menu_editor_t ed;
+		read_item(active, it);
+		memcpy_P(&ed, it.data, sizeof(ed));
+		FORMAT_REAL(edit_value, ed.decimals, value);
+		p = put_row(p, 0, it.label, true);
+		p = put_row(p, 0, value, false);
+	}
+	else if(mode == MODE_VIEW)
+	{
+		menu_view_t view;
+		read_item(active, it);
+		memcpy_P(&view, it.data, sizeof(view));
+		view.render(buf);
+		return;
+	}
+	else if(mode == MODE_NAVIGATE)
+	{
+		const menu_level_t &l = levels[depth];
+		for(uint8_t r = 0; r < MENU_LINES; ++r)
+		{
+			uint8_t i = l.first + r;
+			char cursor = i == l.selected ? '>' : ' ';
+			if(i >= rows())
+			{
+				p = put_row(p, 0, "", false);
+			}
+			else if(i == l.count)
+			{
+				p = put_row(p, cursor, PSTR("Back"), true);
+			}
+			else if(!l.items)
+			{
+				char label[MENU_COLS + 1];
+				menu_item_t owner;
+				menu_list_t list;
+				read_item(l.owner, owner);
+				memcpy_P(&list, owner.data, sizeof(list));
+				list.label(i, label);
+				p = put_row(p, cursor, label, false);
+			}
+			else
+			{
+				read_item(l.items + i, it);
+				p = put_row(p, cursor, it.label, true);
+			}
+		}
+	}
+	*p = 0;
+}
@@ -0,0 +1,103 @@
+#ifndef MENU_H__
+#define MENU_H__
+
+#include <stdint.h>
+
+/*
+	Data-driven menu tree.
+
+	Menus are PROGMEM arrays of menu_item_t and are rendered straight from
+	flash; the RAM state is the navigation stack and the value being edited.
+	An item is one of
+
+	- MENU_SUBMENU: opens data, a menu_item_t[arg] array. Submenus end with
+	  an implicit "Back" row.
+	- MENU_ACTION: calls action(arg).
+	- MENU_EDIT: edits the parameter of data, a menu_editor_t, with up/down;
+	  OK stores it and then calls action(arg) if set.
+	- MENU_LIST: opens data, a menu_list_t whose rows come from callbacks
+	  (e.g. programs in EEPROM); OK on row i calls action(i).
+	- MENU_VIEW: shows data, a menu_view_t, refreshed until OK.
+
+	Actions return true to close the whole menu, false to stay in it.
+*/
+
+#define MENU_LINES 2 // rows of the display
+#define MENU_COLS 16
+#define MENU_MAX_DEPTH 3 // nesting of submenus and lists
+#define MENU_RENDER_SIZE (MENU_LINES * (MENU_COLS + 2) + 1) // rows with CR LF, and the NUL
+
+enum menu_kind_t : uint8_t
+{
+	MENU_SUBMENU,
+	MENU_ACTION,
+	MENU_EDIT,
+	MENU_LIST,
+	MENU_VIEW,
+};
+
+typedef bool (*menu_action_t)(uint8_t arg);
+
+struct menu_item_t
+{
+	const char *label; //!< PROGMEM string
+	menu_kind_t kind;
+	uint8_t arg; //!< item count of a submenu, else passed to action
+	const void *data; //!< PROGMEM submenu items, menu_editor_t, menu_list_t or menu_view_t
+	menu_action_t action;
+};
+
+/**
+ * numeric editor of a parameter, within param_limits(); see params.h
+ * */
+struct menu_editor_t
+{
+	uint8_t param; //!< param_id_t
+	uint8_t decimals; //!< shown after the point
+	float step; //!< per key press
+};
+
+/**
+ * rows computed at display time
+ * */
+struct menu_list_t
+{
+	uint8_t (*count)();
+	void (*label)(uint8_t i, char *buf); //!< buf holds MENU_COLS + 1 bytes
+};
+
+/**
+ * Read-only screen; render writes up to MENU_RENDER_SIZE bytes, rows
+ * separated by CR LF
+ * */
+struct menu_view_t
+{
+	void (*render)(char *buf);
+};
+
+/**
+ * Open the menu at its root, items being a PROGMEM array of count items
+ * */
+void menu_open(const menu_item_t *items, uint8_t count);
+
+/**
+ * Whether the menu is open
+ * */
+bool menu_is_open();
+
+/**
+ * Close the menu, e.g. when a program is started remotely
+ * */
+void menu_close();
+
+/**
+ * Apply key presses; steps is down presses minus up presses
+ * */
+void menu_handle_keys(int8_t steps, bool ok);
+
+/**
+ * Render the current screen into buf of MENU_RENDER_SIZE bytes
+ * */
+void menu_render(char *buf);
+
+#endif
@@ -0,0 +1,77 @@
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <math.h>
+#include "params.h"
+#include "eeprom_layout.h"
+#include "watchdog.h"
+
+/*
+	EEPROM block: count:u8 values:f32[count] crc:u16.
+	The CRC covers count and values. A block whose count differs from
+	NUM_PERSISTENT_PARAMS was written by a firmware with another parameter
+	set and is ignored.
+*/
+
+static_assert(1 + NUM_PERSISTENT_PARAMS * sizeof(float) + 2 <= EEPROM_PARAMS_SIZE, "parameter block too large");
+static_assert((1 + NUM_PERSISTENT_PARAMS * sizeof(float) + 2) * WDT_EEPROM_BYTE_MS <= WDT_MAX_BLOCKING_MS, "params_commit() blocks too long");
+
+#define PARAMS_COUNT_ADDR ((uint8_t *)(uintptr_t)EEPROM_PARAMS_ADDR)
+#define PARAMS_VALUES_ADDR ((float *)(uintptr_t)(EEPROM_PARAMS_ADDR + 1))
+#define PARAMS_CRC_ADDR ((uint16_t *)(uintptr_t)(EEPROM_PARAMS_ADDR + 1 + NUM_PERSISTENT_PARAMS * sizeof(float)))
+
+static uint16_t crc_update(uint16_t crc, const void *p, uint8_t len)
+{
+	for(uint8_t i = 0; i < len; ++i)
+		crc = _crc16_update(crc, ((const uint8_t *)p)[i]);
+	return crc;
+}
+
+bool param_valid(uint8_t id, float value)
+{
+	if(id >= NUM_PARAMS || !isfinite(value)) return false;
+	param_limits_t l = param_limits(id);
+	return l.low <= value && value <= l.high;
+}
+
+void params_commit()
+{
+	uint8_t count = NUM_PERSISTENT_PARAMS;
+	uint16_t crc = crc_update(0xffff, &count, 1);
+	for(uint8_t i = 0; i < NUM_PERSISTENT_PARAMS; ++i)
+	{
+		float v = *param_ptr(PARAM_FIRST_PERSISTENT + i);
+		crc = crc_update(crc, &v, sizeof(v));
+		eeprom_update_block(&v, PARAMS_VALUES_ADDR + i, sizeof(v));
+	}
+	eeprom_update_word(PARAMS_CRC_ADDR, crc);
+	eeprom_update_byte(PARAMS_COUNT_ADDR, count);
+}
+
+bool params_load()
+{
+	uint8_t count = eeprom_read_byte(PARAMS_COUNT_ADDR);
+	if(count != NUM_PERSISTENT_PARAMS) return false;
+
+	float values[NUM_PERSISTENT_PARAMS];
+	eeprom_read_block(values, PARAMS_VALUES_ADDR, sizeof(values));
+	uint16_t crc = crc_update(0xffff, &count, 1);
+	crc = crc_update(crc, values, sizeof(values));
+	if(crc != eeprom_read_word(PARAMS_CRC_ADDR)) return false;
+	for(uint8_t i = 0; i < NUM_PERSISTENT_PARAMS; ++i)
+		if(!param_valid(PARAM_FIRST_PERSISTENT + i, values[i])) return false;
+#define VALUE(id) values[(id) - PARAM_FIRST_PERSISTENT]
+	if(VALUE(PARAM_HEATER_LOW_LIMIT) > VALUE(PARAM_HEATER_HIGH_LIMIT)
+		|| VALUE(PARAM_AIR_LOW_LIMIT) > VALUE(PARAM_AIR_HIGH_LIMIT))
+		return false;
+#undef VALUE
+
+	for(uint8_t i = 0; i < NUM_PERSISTENT_PARAMS; ++i)
+		*param_ptr(PARAM_FIRST_PERSISTENT + i) = values[i];
+	return true;
+}
+
+void params_erase()
+{
+	eeprom_update_byte(PARAMS_COUNT_ADDR, 0);
+}
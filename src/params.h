@@ -0,0 +1,91 @@
+#ifndef PARAMS_H__
+#define PARAMS_H__
+
+#include <stdint.h>
+
+/**
+ * ids of the parameters accessible over the serial protocol
+ * */
+enum param_id_t : uint8_t
+{
+	PARAM_HEATER_SET_POINT,
+	PARAM_AIR_SET_POINT,
+
+	PARAM_HEATER_KP,
+	PARAM_HEATER_KI,
+	PARAM_HEATER_KD,
+	PARAM_HEATER_KILIM,
+	PARAM_HEATER_KIRC,
+	PARAM_HEATER_KDC,
+	PARAM_HEATER_EFFECTIVE_RANGE,
+	PARAM_HEATER_LOW_LIMIT,
+	PARAM_HEATER_HIGH_LIMIT,
+
+	PARAM_AIR_KP,
+	PARAM_AIR_KI,
+	PARAM_AIR_KD,
+	PARAM_AIR_KILIM,
+	PARAM_AIR_KIRC,
+	PARAM_AIR_KDC,
+	PARAM_AIR_EFFECTIVE_RANGE,
+	PARAM_AIR_LOW_LIMIT,
+	PARAM_AIR_HIGH_LIMIT,
+
+	PARAM_HEATER_POWER_INCREMENT,
+	PARAM_HEATER_POWER_DECREMENT,
+	PARAM_AIR_TEMP_LPF_COEFF,
+	PARAM_HEATER_WATTS,
+	PARAM_FEED_FORWARD_GAIN,
+	PARAM_HISTORY_INTERVAL,
+
+	NUM_PARAMS
+};
+
+// parameters from this id on are saved to EEPROM; set points are not
+#define PARAM_FIRST_PERSISTENT PARAM_HEATER_KP
+#define NUM_PERSISTENT_PARAMS (NUM_PARAMS - PARAM_FIRST_PERSISTENT)
+
+/**
+ * Pointer to the live value of the parameter; implemented by the application
+ * */
+float *param_ptr(uint8_t id);
+
+/**
+ * accepted range of a parameter
+ * */
+struct param_limits_t
+{
+	float low;
+	float high;
+};
+
+/**
+ * Range of the parameter, applied to values from the serial protocol, the
+ * menu and EEPROM; implemented by the application
+ * */
+param_limits_t param_limits(uint8_t id);
+
+/**
+ * Whether value is finite and within the limits of the parameter
+ * */
+bool param_valid(uint8_t id, float value);
+
+/**
+ * Save live values of the persistent parameters to EEPROM
+ * */
+void params_commit();
+
+/**
+ * Load persistent parameters from EEPROM. Returns false, leaving the live
+ * values untouched, if EEPROM holds no valid parameter block, a value out
+ * of its limits or a low output limit above its high limit.
+ * */
+bool params_load();
+
+/**
+ * Invalidate the parameters in EEPROM so that the compiled-in defaults are
+ * used from the next boot
+ * */
+void params_erase();
+
+#endif
@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include "pid.h"
+#include "thermistor_fx.h"
 #include <math.h>
 
 float pid_controller_t::update(float pv)
@@ -21,7 +22,8 @@ float pid_controller_t::update(float pv)
     last_p = kp * error;
     last_i = ki * integ;
     last_d = kd * derinteg;
-    float output = last_p + last_i + last_d;
+    last_ff = feed_forward;
+    float output = last_p + last_i + last_d + last_ff;
 
     // update previous process value
     perror = error;
@@ -30,7 +32,8 @@ float pid_controller_t::update(float pv)
     if(output < low_limit) output = low_limit;
     else if(output > high_limit) output = high_limit;
 
-    if(error < -effective_range || error > effective_range)
+    out_of_range = error < -effective_range || error > effective_range;
+    if(out_of_range)
     {
         if(setpoint <= pv)
             output = low_limit;
@@ -44,31 +47,34 @@ float pid_controller_t::update(float pv)
 void pid_controller_t::dump()
 {
     Serial.print(F(" kp:"));
-    Serial.print(kp);
+    PRINT_REAL(kp);
 
     Serial.print(F(" ki:"));
-    Serial.print(ki);
+    PRINT_REAL(ki);
 
     Serial.print(F(" kd:"));
-    Serial.print(kd);
+    PRINT_REAL(kd);
 
     Serial.print(F("\r\n integ:"));
-    Serial.print(integ);
+    PRINT_REAL(integ);
 
     Serial.print(F(" perror:"));
-    Serial.print(perror);
+    PRINT_REAL(perror);
 
     Serial.print(F(" derinteg:"));
-    Serial.print(derinteg);
+    PRINT_REAL(derinteg);
 
     Serial.print(F("\r\n last_p:"));
-    Serial.print(last_p);
+    PRINT_REAL(last_p);
 
     Serial.print(F(" last_i:"));
-    Serial.print(last_i);
+    PRINT_REAL(last_i);
 
     Serial.print(F(" last_d:"));
-    Serial.print(last_d);
+    PRINT_REAL(last_d);
+
+    Serial.print(F(" last_ff:"));
+    PRINT_REAL(last_ff);
 
     Serial.println(F(""));
 
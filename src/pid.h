@@ -16,6 +16,7 @@ public:
 	float effective_range; //!< pid effective range
 	float low_limit; //!< output range low
 	float high_limit; //!< output range high
+	float feed_forward; //!< added to the output before clamping; 0 for pure feedback
 
 private:
 	float integ; //!< integrated error value
@@ -24,13 +25,16 @@ private:
 	float last_p;
 	float last_i;
 	float last_d;
+	float last_ff;
+	bool out_of_range; //!< the last update was outside effective_range
 
 public:
-	pid_controller_t() : kp(0), ki(0), kd(0), kilim(0), kirc(0), kdc(0), setpoint(0), effective_range(0), low_limit(0), high_limit(0),
+	pid_controller_t() : kp(0), ki(0), kd(0), kilim(0), kirc(0), kdc(0), setpoint(0), effective_range(0), low_limit(0), high_limit(0), feed_forward(0),
 		integ(0),
 		perror(0),
 		derinteg(0),
-		last_p(0), last_i(0), last_d(0)
+		last_p(0), last_i(0), last_d(0), last_ff(0),
+		out_of_range(false)
 		 {}
 	pid_controller_t(float kp_, float ki_, float kd_, float kilim_, float kirc_, float kdc_, float eff_, float low_, float high_):
 		pid_controller_t()
@@ -54,7 +58,8 @@ public:
 		integ = 0;
 		perror = 0;
 		derinteg = 0;
-		last_p = last_i = last_d = 0;
+		last_p = last_i = last_d = last_ff = 0;
+		out_of_range = false;
 	}
 
 	/**
@@ -67,6 +72,11 @@ public:
 	 * */
 	void set_set_point(float v) { setpoint = v;}
 
+	/**
+	 * true if the last update was outside effective_range, where the output is bang-bang
+	 * */
+	bool saturated() const { return out_of_range; }
+
 	/**
 	 * dump internal variables
 	 * */
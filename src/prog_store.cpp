@@ -0,0 +1,282 @@
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "prog_store.h"
+#include "program.h"
+#include "eeprom_layout.h"
+
+/*
+	Each slot holds a header followed by the program words. The header is
+	invalidated first when a program is uploaded and rewritten with a CRC over
+	the name and the words only after the whole program has been received and
+	validated, so an interrupted upload leaves an empty slot, never a
+	partially written program.
+*/
+
+#define PROG_STORE_FORMAT 1 // 16-bit variable length encoding; see program.h
+
+struct prog_store_header_t
+{
+	char name[PROG_STORE_NAME_LEN];
+	uint8_t length; //!< number of program words
+	uint8_t format; //!< PROG_STORE_FORMAT
+	uint16_t crc; //!< crc16 over name, length, format and the words
+};
+static_assert(sizeof(prog_store_header_t) + PROG_STORE_MAX_WORDS * sizeof(uint16_t) <= EEPROM_PROG_STORE_SLOT_SIZE,
+	"program slot too small");
+
+static uint8_t locked_slot = PROG_STORE_SLOTS;
+
+static prog_store_header_t *header_addr(uint8_t slot)
+{
+	return (prog_store_header_t *)(uintptr_t)(EEPROM_PROG_STORE_ADDR + slot * EEPROM_PROG_STORE_SLOT_SIZE);
+}
+
+static uint16_t *words_addr(uint8_t slot)
+{
+	return (uint16_t *)(header_addr(slot) + 1);
+}
+
+static uint16_t compute_crc(uint8_t slot, const prog_store_header_t &h)
+{
+	uint16_t crc = 0xffff;
+	const uint8_t *p = (const uint8_t *)&h;
+	for(uint8_t i = 0; i < offsetof(prog_store_header_t, crc); ++i)
+		crc = _crc16_update(crc, p[i]);
+	const uint8_t *e = (const uint8_t *)words_addr(slot);
+	for(uint16_t i = 0; i < h.length * sizeof(uint16_t); ++i)
+		crc = _crc16_update(crc, eeprom_read_byte(e + i));
+	return crc;
+}
+
+static bool read_header(uint8_t slot, prog_store_header_t &h)
+{
+	if(slot >= PROG_STORE_SLOTS) return false;
+	eeprom_read_block(&h, header_addr(slot), sizeof(h));
+	if(h.length == 0 || h.length > PROG_STORE_MAX_WORDS || h.format != PROG_STORE_FORMAT) return false;
+	return h.crc == compute_crc(slot, h);
+}
+
+static void invalidate(uint8_t slot)
+{
+	eeprom_update_byte(&header_addr(slot)->length, 0);
+}
+
+bool prog_store_get_name(uint8_t slot, char *name)
+{
+	prog_store_header_t h;
+	if(!read_header(slot, h)) return false;
+	memcpy(name, h.name, PROG_STORE_NAME_LEN);
+	name[PROG_STORE_NAME_LEN - 1] = 0;
+	return true;
+}
+
+void prog_store_read(uint8_t slot, uint16_t ip, uint16_t *words, uint8_t count)
+{
+	uint8_t length = eeprom_read_byte(&header_addr(slot)->length);
+	for(uint8_t i = 0; i < count; ++i, ++ip)
+	{
+		if(ip < length)
+			words[i] = eeprom_read_word(words_addr(slot) + ip);
+		else
+			words[i] = 0; // PROG_END
+	}
+}
+
+void prog_store_lock(uint8_t slot)
+{
+	locked_slot = slot;
+}
+
+
+// upload command parser
+enum upload_state_t : uint8_t
+{
+	UP_IDLE, //!< not in a command
+	UP_CMD, //!< waiting for the command letter
+	UP_SLOT, //!< waiting for the slot number
+	UP_NAME, //!< receiving the program name
+	UP_OP, //!< receiving an opcode
+	UP_ARG, //!< receiving an argument
+	UP_DONE, //!< waiting for the end of line
+	UP_ERROR, //!< skipping to the end of line
+};
+
+static upload_state_t up_state = UP_IDLE;
+static char up_cmd;
+static uint8_t up_slot;
+static uint8_t up_count; //!< number of name chars or program words received
+static uint8_t up_op;
+static uint32_t up_num;
+static bool up_has_digit;
+static bool up_ended; //!< PROG_END received
+
+static void list_programs()
+{
+	for(uint8_t slot = 0; slot < PROG_STORE_SLOTS; ++slot)
+	{
+		char name[PROG_STORE_NAME_LEN];
+		Serial.print(F("!P"));
+		Serial.print((int)slot);
+		Serial.print(' ');
+		if(prog_store_get_name(slot, name))
+			Serial.print(name);
+		Serial.print(F("\r\n"));
+	}
+}
+
+// write one received instruction
+static bool upload_word()
+{
+	if(up_ended || !prog_insn_valid(up_op, up_num)) return false;
+	if(up_count + prog_insn_length(up_num) > PROG_STORE_MAX_WORDS) return false;
+	uint16_t words[PROG_MAX_INSN_WORDS];
+	uint8_t len = prog_encode_insn(up_op, up_num, words);
+	for(uint8_t i = 0; i < len; ++i)
+		eeprom_update_word(words_addr(up_slot) + up_count++, words[i]);
+	if(up_op == PROG_END) up_ended = true;
+	Serial.write('+');
+	return true;
+}
+
+// finish the command at the end of line
+static bool finish_command()
+{
+	if(up_state == UP_ERROR || up_state == UP_CMD) return false;
+
+	switch(up_cmd)
+	{
+	case 'L':
+		list_programs();
+		return true;
+
+	case 'D':
+		if(up_state != UP_NAME || up_count != 0) return false;
+		invalidate(up_slot);
+		return true;
+
+	case 'P':
+		if(up_state == UP_ARG && up_has_digit)
+		{
+			if(!upload_word()) return false;
+		}
+		else if(up_state != UP_OP || up_has_digit)
+			return false;
+		if(!up_ended) return false;
+
+		{
+			prog_store_header_t h;
+			eeprom_read_block(&h, header_addr(up_slot), sizeof(h));
+			h.length = up_count;
+			h.format = PROG_STORE_FORMAT;
+			h.crc = compute_crc(up_slot, h);
+			eeprom_update_block(&h, header_addr(up_slot), sizeof(h));
+		}
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+bool prog_upload_feed(int c)
+{
+	if(up_state == UP_IDLE)
+	{
+		if(c != '!') return false;
+		up_state = UP_CMD;
+		return true;
+	}
+
+	if(c == '\r') return true;
+	if(c == '\n')
+	{
+		Serial.print(finish_command() ? F("!OK\r\n") : F("!ERR\r\n"));
+		up_state = UP_IDLE;
+		return true;
+	}
+
+	bool digit = c >= '0' && c <= '9';
+	switch(up_state)
+	{
+	case UP_CMD:
+		up_cmd = c;
+		up_state = (c == 'P' || c == 'D') ? UP_SLOT : (c == 'L' ? UP_DONE : UP_ERROR);
+		break;
+
+	case UP_SLOT:
+		up_slot = c - '0';
+		if(!digit || up_slot >= PROG_STORE_SLOTS || up_slot == locked_slot)
+		{
+			up_state = UP_ERROR;
+			break;
+		}
+		if(up_cmd == 'P') invalidate(up_slot);
+		up_count = 0;
+		up_ended = false;
+		up_state = UP_NAME;
+		break;
+
+	case UP_NAME:
+		if(c == ' ')
+		{
+			if(up_count == 0) break; // skip leading spaces
+			// terminate the name
+			eeprom_update_byte((uint8_t *)header_addr(up_slot)->name + up_count, 0);
+			up_count = 0;
+			up_num = 0;
+			up_has_digit = false;
+			up_state = UP_OP;
+		}
+		else if(up_cmd == 'P' && c > ' ' && c < 0x7f && up_count < PROG_STORE_NAME_LEN - 1)
+		{
+			eeprom_update_byte((uint8_t *)header_addr(up_slot)->name + up_count, c);
+			++ up_count;
+		}
+		else
+			up_state = UP_ERROR;
+		break;
+
+	case UP_OP:
+	case UP_ARG:
+		if(digit)
+		{
+			if(up_num > (UINT32_MAX - 9) / 10)
+			{
+				up_state = UP_ERROR;
+				break;
+			}
+			up_num = up_num * 10 + (c - '0');
+			up_has_digit = true;
+		}
+		else if(up_state == UP_OP && c == ':' && up_has_digit)
+		{
+			up_op = up_num > 0xff ? 0xff : up_num;
+			up_num = 0;
+			up_has_digit = false;
+			up_state = UP_ARG;
+		}
+		else if(up_state == UP_ARG && c == ' ' && up_has_digit)
+		{
+			if(!upload_word())
+			{
+				up_state = UP_ERROR;
+				break;
+			}
+			up_num = 0;
+			up_has_digit = false;
+			up_state = UP_OP;
+		}
+		else if(!(up_state == UP_OP && c == ' ' && !up_has_digit))
+			up_state = UP_ERROR;
+		break;
+
+	case UP_DONE:
+		if(c != ' ') up_state = UP_ERROR;
+		break;
+
+	default:;
+	}
+
+	return true;
+}
@@ -0,0 +1,41 @@
+#ifndef PROG_STORE_H__
+#define PROG_STORE_H__
+
+#include <stdint.h>
+
+#define PROG_STORE_SLOTS 4 // number of user programs
+#define PROG_STORE_NAME_LEN 12 // including terminating NUL
+#define PROG_STORE_MAX_WORDS 48 // max program words per slot
+
+/**
+ * Get the name of the program stored in the slot.
+ * Returns false if the slot is empty or its content is corrupted.
+ * */
+bool prog_store_get_name(uint8_t slot, char *name);
+
+/**
+ * Read program words. Words past the end of the program read as PROG_END.
+ * */
+void prog_store_read(uint8_t slot, uint16_t ip, uint16_t *words, uint8_t count);
+
+/**
+ * Protect a slot from being overwritten while its program is running.
+ * Pass PROG_STORE_SLOTS to unlock.
+ * */
+void prog_store_lock(uint8_t slot);
+
+/**
+ * Feed a character received from serial to the program upload command parser.
+ * Returns true if the character was consumed by the parser.
+ *
+ * Commands are lines beginning with '!':
+ *   !P<slot> <name> <op>:<arg> <op>:<arg> ...   store a program; must end with PROG_END
+ *   !D<slot>                                    delete a program
+ *   !L                                          list programs
+ * Each command is answered with "!OK" or "!ERR". Each accepted instruction is
+ * acknowledged with '+' after it is written to EEPROM; the sender should wait
+ * for it before sending the next instruction to avoid receive buffer overrun.
+ * */
+bool prog_upload_feed(int c);
+
+#endif
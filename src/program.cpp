@@ -0,0 +1,36 @@
+#include <Arduino.h>
+#include "program.h"
+#include "prog_store.h"
+
+uint16_t prog_reader_t::fetch_word(uint16_t ip)
+{
+	if(flash) return pgm_read_word(flash + ip);
+
+	if(ip < cache_base || ip >= cache_base + PROG_CACHE_WORDS)
+	{
+		// cache miss; read ahead
+		cache_base = ip;
+		prog_store_read(slot, ip, cache, PROG_CACHE_WORDS);
+	}
+	return cache[ip - cache_base];
+}
+
+uint8_t prog_reader_t::fetch(uint16_t ip, uint8_t &op, uint32_t &arg)
+{
+	uint16_t w = fetch_word(ip);
+	op = w >> 12;
+	arg = w & 0x07ff;
+
+	uint8_t len = 1;
+	uint8_t shift = PROG_HEAD_ARG_BITS;
+	bool more = w & 0x0800;
+	while(more && len < PROG_MAX_INSN_WORDS)
+	{
+		w = fetch_word(ip + len);
+		arg |= (uint32_t)(w & 0x7fff) << shift;
+		shift += PROG_EXT_ARG_BITS;
+		more = w & 0x8000;
+		++ len;
+	}
+	return len;
+}
@@ -0,0 +1,112 @@
+#ifndef PROGRAM_H__
+#define PROGRAM_H__
+
+#include <stdint.h>
+
+// program opecodes
+#define PROG_END    0
+#define PROG_DWELL  1
+#define PROG_SET_HEATER_TEMP 2
+#define PROG_WAIT_HEATER_TEMP 3
+#define PROG_SET_AIR_TEMP 4
+#define PROG_WAIT_AIR_TEMP 5
+#define PROG_WAIT_BUTTON 6
+#define PROG_SET_TONE_REPEAT 7
+#define PROG_SET_TONE 8
+#define PROG_DWELL_MIN 9 // dwell in minutes
+#define PROG_SET_WAIT_HEATER_TEMP 10 // PROG_SET_HEATER_TEMP then PROG_WAIT_HEATER_TEMP
+#define PROG_SET_WAIT_AIR_TEMP 11 // PROG_SET_AIR_TEMP then PROG_WAIT_AIR_TEMP
+#define PROG_NUM_OPCODES 16 // 12..15 are reserved
+
+/*
+	Programs are sequences of 16-bit words. An instruction is one head word
+	followed by zero or more extension words:
+
+	  head word:      [opcode:4][more:1][arg bits 0..10:11]
+	  extension word: [more:1][next 15 arg bits:15]
+
+	"more" tells that an extension word follows. Temperatures and most minute
+	counts fit in the head word alone.
+*/
+#define PROG_HEAD_ARG_BITS 11
+#define PROG_EXT_ARG_BITS 15
+#define PROG_MAX_INSN_WORDS 3 // enough for a 32-bit argument
+
+// argument limits
+#define PROG_TEMP_MAX 400 // must match TEMP_TARGETABLE_HIGH
+#define PROG_DWELL_MAX (60UL*60*24) // one day
+
+/**
+ * Check whether the opcode is known and the argument is in range
+ * */
+constexpr bool prog_insn_valid(uint8_t op, uint32_t arg)
+{
+	return
+		(op == PROG_END || op == PROG_WAIT_BUTTON) ? arg == 0 :
+		op == PROG_DWELL ? arg <= PROG_DWELL_MAX :
+		op == PROG_DWELL_MIN ? arg <= PROG_DWELL_MAX / 60 :
+		(op == PROG_SET_HEATER_TEMP || op == PROG_WAIT_HEATER_TEMP || op == PROG_SET_WAIT_HEATER_TEMP ||
+		 op == PROG_SET_AIR_TEMP || op == PROG_WAIT_AIR_TEMP || op == PROG_SET_WAIT_AIR_TEMP) ? arg <= PROG_TEMP_MAX :
+		(op == PROG_SET_TONE_REPEAT || op == PROG_SET_TONE) ? true :
+		false;
+}
+
+/**
+ * Number of words needed to encode the argument
+ * */
+constexpr uint8_t prog_insn_length(uint32_t arg)
+{
+	return (arg >> PROG_HEAD_ARG_BITS) == 0 ? 1 :
+		(arg >> (PROG_HEAD_ARG_BITS + PROG_EXT_ARG_BITS)) == 0 ? 2 : 3;
+}
+
+/**
+ * Encode one instruction to out[]. Returns the number of words written.
+ * */
+constexpr uint8_t prog_encode_insn(uint8_t op, uint32_t arg, uint16_t *out)
+{
+	uint8_t len = prog_insn_length(arg);
+	out[0] = ((uint16_t)op << 12) | (len > 1 ? 0x0800 : 0) | (arg & 0x07ff);
+	arg >>= PROG_HEAD_ARG_BITS;
+	for(uint8_t i = 1; i < len; ++i)
+	{
+		out[i] = (i + 1 < len ? 0x8000 : 0) | (arg & 0x7fff);
+		arg >>= PROG_EXT_ARG_BITS;
+	}
+	return len;
+}
+
+#define PROG_CACHE_WORDS 4 // EEPROM read-ahead cache size, in words
+
+/**
+ * Program fetcher, reading either a PROGMEM program or a program stored in EEPROM
+ * */
+class prog_reader_t
+{
+	const uint16_t *flash; //!< PROGMEM program, or nullptr if reading from EEPROM
+	uint8_t slot; //!< EEPROM program slot
+	uint16_t cache_base; //!< ip of cache[0]
+	uint16_t cache[PROG_CACHE_WORDS];
+
+	uint16_t fetch_word(uint16_t ip);
+
+public:
+	prog_reader_t() : flash(nullptr), slot(0), cache_base(UINT16_MAX) {}
+
+	/**
+	 * read program from PROGMEM
+	 * */
+	void open_flash(const uint16_t *p) { flash = p; }
+
+	/**
+	 * read program from EEPROM slot
+	 * */
+	void open_store(uint8_t s) { flash = nullptr; slot = s; cache_base = UINT16_MAX; }
+
+	/**
+	 * decode the instruction at ip. returns the number of words it occupies.
+	 * */
+	uint8_t fetch(uint16_t ip, uint8_t &op, uint32_t &arg);
+};
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef PROGRAM_BUILDER_H__
+#define PROGRAM_BUILDER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "program.h"
+
+/*
+	Compile-time program builder.
+
+	  PROG_BUILD(PROG1,
+	      prog_set_air_temp(160),
+	      prog_wait_air_temp(160),
+	      prog_dwell(60*60*0.9),
+	      prog_end());
+
+	defines a PROGMEM program image PROG1. Every argument is checked at compile
+	time; a negative, fractional or out-of-range argument fails a static_assert
+	instead of being silently truncated. The encoder picks the densest form:
+	whole minutes use PROG_DWELL_MIN and a set followed by a wait for the same
+	temperature is fused into one PROG_SET_WAIT_* instruction.
+*/
+
+/**
+ * one source instruction
+ * */
+struct prog_insn_t
+{
+	uint8_t op;
+	uint32_t arg;
+	bool exact; //!< whether the argument given was a non-negative integer fitting in 32 bits
+
+	template <typename T>
+	constexpr prog_insn_t(uint8_t op_, T arg_) :
+		op(op_),
+		arg(arg_ >= 0 && (double)arg_ <= 4294967295.0 ? (uint32_t)arg_ : 0),
+		exact(arg_ >= 0 && (double)arg_ <= 4294967295.0 && (T)(uint32_t)arg_ == arg_)
+		{}
+};
+
+template <typename T> constexpr prog_insn_t prog_dwell(T secs) { return prog_insn_t(PROG_DWELL, secs); }
+template <typename T> constexpr prog_insn_t prog_set_heater_temp(T t) { return prog_insn_t(PROG_SET_HEATER_TEMP, t); }
+template <typename T> constexpr prog_insn_t prog_wait_heater_temp(T t) { return prog_insn_t(PROG_WAIT_HEATER_TEMP, t); }
+template <typename T> constexpr prog_insn_t prog_set_air_temp(T t) { return prog_insn_t(PROG_SET_AIR_TEMP, t); }
+template <typename T> constexpr prog_insn_t prog_wait_air_temp(T t) { return prog_insn_t(PROG_WAIT_AIR_TEMP, t); }
+template <typename T> constexpr prog_insn_t prog_set_tone(T pattern) { return prog_insn_t(PROG_SET_TONE, pattern); }
+template <typename T> constexpr prog_insn_t prog_set_tone_repeat(T pattern) { return prog_insn_t(PROG_SET_TONE_REPEAT, pattern); }
+constexpr prog_insn_t prog_wait_button() { return prog_insn_t(PROG_WAIT_BUTTON, 0); }
+constexpr prog_insn_t prog_end() { return prog_insn_t(PROG_END, 0); }
+
+/**
+ * Check all instructions and that the program ends with PROG_END
+ * */
+template <size_t N>
+constexpr bool prog_check(const prog_insn_t (&src)[N])
+{
+	for(size_t i = 0; i < N; ++i)
+	{
+		if(!src[i].exact || !prog_insn_valid(src[i].op, src[i].arg)) return false;
+	}
+	return src[N - 1].op == PROG_END;
+}
+
+/**
+ * Translate src[i] into its densest form. Returns the number of source
+ * instructions consumed.
+ * */
+template <size_t N>
+constexpr size_t prog_optimize(const prog_insn_t (&src)[N], size_t i, uint8_t &op, uint32_t &arg)
+{
+	op = src[i].op;
+	arg = src[i].arg;
+	if(op == PROG_DWELL && arg % 60 == 0)
+	{
+		op = PROG_DWELL_MIN;
+		arg /= 60;
+	}
+	else if(i + 1 < N && arg == src[i + 1].arg &&
+		((op == PROG_SET_HEATER_TEMP && src[i + 1].op == PROG_WAIT_HEATER_TEMP) ||
+		 (op == PROG_SET_AIR_TEMP && src[i + 1].op == PROG_WAIT_AIR_TEMP)))
+	{
+		op = op == PROG_SET_HEATER_TEMP ? PROG_SET_WAIT_HEATER_TEMP : PROG_SET_WAIT_AIR_TEMP;
+		return 2;
+	}
+	return 1;
+}
+
+/**
+ * Number of words of the encoded program
+ * */
+template <size_t N>
+constexpr size_t prog_encoded_length(const prog_insn_t (&src)[N])
+{
+	size_t len = 0;
+	for(size_t i = 0; i < N; )
+	{
+		uint8_t op = 0;
+		uint32_t arg = 0;
+		i += prog_optimize(src, i, op, arg);
+		len += prog_insn_length(arg);
+	}
+	return len;
+}
+
+/**
+ * encoded program image
+ * */
+template <size_t LEN>
+struct prog_image_t
+{
+	uint16_t words[LEN];
+};
+
+template <size_t LEN, size_t N>
+constexpr prog_image_t<LEN> prog_encode(const prog_insn_t (&src)[N])
+{
+	prog_image_t<LEN> image = {};
+	size_t pos = 0;
+	for(size_t i = 0; i < N; )
+	{
+		uint8_t op = 0;
+		uint32_t arg = 0;
+		i += prog_optimize(src, i, op, arg);
+		pos += prog_encode_insn(op, arg, image.words + pos);
+	}
+	return image;
+}
+
+#define PROG_BUILD(NAME, ...) \
+	static constexpr prog_insn_t NAME##_SRC[] = { __VA_ARGS__ }; \
+	static_assert(prog_check(NAME##_SRC), #NAME ": argument out of range, not an integer, or missing prog_end()"); \
+	static PROGMEM const prog_image_t<prog_encoded_length(NAME##_SRC)> NAME = \
+		prog_encode<prog_encoded_length(NAME##_SRC)>(NAME##_SRC)
+
+#endif
@@ -0,0 +1,101 @@
+#include <Arduino.h>
+#include <util/crc16.h>
+#include "serial_proto.h"
+
+enum proto_state_t : uint8_t
+{
+	PS_IDLE,
+	PS_LEN,
+	PS_DATA,
+	PS_CRC_LO,
+	PS_CRC_HI,
+	PS_DISCARD, //!< skipping the rest of a rejected frame
+};
+
+static proto_state_t ps_state = PS_IDLE;
+static uint8_t ps_len;
+static uint8_t ps_pos;
+static uint16_t ps_crc;
+static uint8_t ps_crc_lo;
+static uint16_t ps_remain; // bytes left in the frame, including the CRC
+static uint32_t ps_start_ms;
+static uint32_t ps_last_ms; // millis() of the previous byte of the frame
+static uint8_t ps_buf[SERIAL_PROTO_MAX_PAYLOAD];
+
+bool serial_proto_feed(int c)
+{
+	uint32_t now = millis();
+	if(ps_state != PS_IDLE)
+	{
+		if(now - ps_last_ms > SERIAL_PROTO_TIMEOUT_MS)
+			ps_state = PS_IDLE; // the line went idle; c starts afresh
+		else if(now - ps_start_ms > SERIAL_PROTO_TIMEOUT_MS)
+		{
+			// too slow; drop the rest of the frame. Never in PS_LEN, as its
+			// previous byte is the SYNC that started the frame
+			ps_state = PS_DISCARD;
+		}
+	}
+	ps_last_ms = now;
+
+	switch(ps_state)
+	{
+	case PS_IDLE:
+		if(c != SERIAL_PROTO_SYNC) return false;
+		ps_start_ms = now;
+		ps_crc = 0xffff;
+		ps_state = PS_LEN;
+		break;
+
+	case PS_LEN:
+		ps_remain = c + 2;
+		if(c == 0 || c > SERIAL_PROTO_MAX_PAYLOAD)
+		{
+			ps_state = PS_DISCARD;
+			break;
+		}
+		ps_len = c;
+		ps_pos = 0;
+		ps_crc = _crc_xmodem_update(ps_crc, c);
+		ps_state = PS_DATA;
+		break;
+
+	case PS_DATA:
+		--ps_remain;
+		ps_buf[ps_pos++] = c;
+		ps_crc = _crc_xmodem_update(ps_crc, c);
+		if(ps_pos == ps_len) ps_state = PS_CRC_LO;
+		break;
+
+	case PS_CRC_LO:
+		--ps_remain;
+		ps_crc_lo = c;
+		ps_state = PS_CRC_HI;
+		break;
+
+	case PS_CRC_HI:
+		ps_state = PS_IDLE;
+		if(ps_crc == (uint16_t)(ps_crc_lo | (c << 8)))
+			serial_proto_dispatch(ps_buf[0], ps_buf + 1, ps_len - 1);
+		break;
+
+	case PS_DISCARD:
+		if(--ps_remain == 0) ps_state = PS_IDLE;
+		break;
+	}
+	return true;
+}
+
+void serial_proto_reply(uint8_t cmd, uint8_t status, const void *data, uint8_t len)
+{
+	uint8_t hdr[3] = { (uint8_t)(len + 2), (uint8_t)(cmd | CMD_REPLY), status };
+	uint16_t crc = 0xffff;
+	for(uint8_t b : hdr) crc = _crc_xmodem_update(crc, b);
+	for(uint8_t i = 0; i < len; ++i) crc = _crc_xmodem_update(crc, ((const uint8_t *)data)[i]);
+
+	Serial.write(SERIAL_PROTO_SYNC);
+	Serial.write(hdr, sizeof(hdr));
+	Serial.write((const uint8_t *)data, len);
+	Serial.write(crc & 0xff);
+	Serial.write(crc >> 8);
+}
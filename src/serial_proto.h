@@ -0,0 +1,92 @@
+#ifndef SERIAL_PROTO_H__
+#define SERIAL_PROTO_H__
+
+#include <stdint.h>
+
+/*
+	Binary command protocol over the serial line.
+
+	  frame: SYNC LEN CMD ARGS[LEN-1] CRC_LO CRC_HI
+
+	LEN counts CMD and ARGS. CRC is CRC-16/CCITT-FALSE (poly 0x1021,
+	init 0xffff) over LEN, CMD and ARGS. Replies use the same framing with
+	CMD | CMD_REPLY followed by a status byte and the reply data. Multi-byte
+	values are little endian; floats are IEEE754 single precision.
+
+	Bytes outside a frame are left to the text commands and the key shim, so
+	the protocol coexists with them. A rejected frame, with LEN 0 or above
+	SERIAL_PROTO_MAX_PAYLOAD or not complete within SERIAL_PROTO_TIMEOUT_MS,
+	is still consumed up to its declared length, or until the line has been
+	idle for SERIAL_PROTO_TIMEOUT_MS, so its bytes never reach the text
+	commands.
+*/
+
+#define SERIAL_PROTO_SYNC 0xa5
+#define SERIAL_PROTO_MAX_PAYLOAD 32 // max LEN of a request
+#define SERIAL_PROTO_MAX_REPLY 64 // max LEN of a reply
+#define SERIAL_PROTO_DUMP_CHUNK 48 // dump stream bytes per CMD_GET_HISTORY or CMD_GET_CAPTURE reply
+#define SERIAL_PROTO_TIMEOUT_MS 100 // a frame must complete within this
+
+// commands
+#define CMD_GET_STATUS 0x01 // -> status_reply_t
+#define CMD_SET_PARAMS 0x02 // n * (id:u8, value:f32); applied together at the next control cycle; rejected whole if an id is unknown, a value is outside param_limits() or a low output limit would end up above its high limit
+#define CMD_GET_PARAMS 0x03 // n * id:u8 -> n * value:f32
+#define CMD_START_PROGRAM 0x04 // index:u8
+#define CMD_STOP_PROGRAM 0x05
+#define CMD_COMMIT_PARAMS 0x06 // save tunable parameters to EEPROM
+#define CMD_LOAD_PARAMS 0x07 // revert tunable parameters to the values in EEPROM
+#define CMD_ERASE_PARAMS 0x08 // use compiled-in defaults from the next boot
+#define CMD_GET_RESET_INFO 0x09 // -> watchdog_reset_info_t
+#define CMD_ERASE_FEED_FORWARD 0x0a // forget the learned hold powers
+#define CMD_GET_HISTORY 0x0b // offset:u16 -> total:u16, up to SERIAL_PROTO_DUMP_CHUNK bytes of the history dump; see history.h
+#define CMD_ARM_CAPTURE 0x0c // mask:u8, pre_trigger:u8, divider:u8; see capture.h
+#define CMD_TRIGGER_CAPTURE 0x0d // fire the manual capture trigger
+#define CMD_GET_CAPTURE 0x0e // offset:u16 -> total:u16, up to SERIAL_PROTO_DUMP_CHUNK bytes of the capture dump
+#define CMD_GET_MEM_STATS 0x0f // -> mem_stats_t
+#define CMD_REPLY 0x80
+
+/**
+ * CMD_GET_STATUS reply data
+ * */
+struct __attribute__((packed)) status_reply_t
+{
+	float heater_set_point;
+	float heater_temp;
+	float air_set_point;
+	float air_temp;
+	float env_temp;
+	uint16_t heater_power; //!< 0 to HEATER_POWER_MAX
+	uint8_t prog; //!< running program index, 0xff if none
+	uint16_t prog_ip; //!< instruction pointer of the running program
+	int32_t secs_remain; //!< remaining dwell seconds
+	float energy_wh; //!< heater energy of the running or last program
+	int32_t eta_secs; //!< predicted seconds until the program ends, -1 if unknown
+};
+
+static_assert(2 + sizeof(status_reply_t) <= SERIAL_PROTO_MAX_REPLY, "status reply too large");
+static_assert(2 + 2 + SERIAL_PROTO_DUMP_CHUNK <= SERIAL_PROTO_MAX_REPLY, "dump reply too large");
+
+// reply status
+#define STATUS_OK 0
+#define STATUS_BAD_COMMAND 1
+#define STATUS_BAD_ARGUMENT 2
+#define STATUS_BUSY 3
+
+/**
+ * Feed a character received from serial to the frame parser.
+ * Returns true if the character was consumed as a part of a frame.
+ * */
+bool serial_proto_feed(int c);
+
+/**
+ * Send a reply frame
+ * */
+void serial_proto_reply(uint8_t cmd, uint8_t status, const void *data, uint8_t len);
+
+/**
+ * Handle a received frame with a valid CRC; implemented by the application.
+ * Must send exactly one reply.
+ * */
+void serial_proto_dispatch(uint8_t cmd, const uint8_t *args, uint8_t len);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef SPSC_RING_H__
+#define SPSC_RING_H__
+
+#include <stdint.h>
+
+/**
+ * Lock-free single-producer/single-consumer ring buffer.
+ * The producer only writes head and the consumer only writes tail; both are
+ * single bytes, which the AVR reads and writes atomically, so an interrupt
+ * handler may produce while the main loop consumes without disabling
+ * interrupts. N must be a power of two not greater than 128.
+ * */
+template <typename T, uint8_t N>
+class spsc_ring_t
+{
+	static_assert(N != 0 && (N & (N - 1)) == 0 && N <= 128, "N must be a power of two up to 128");
+
+	T buf[N];
+	volatile uint8_t head; //!< next position to write; producer owned
+	volatile uint8_t tail; //!< next position to read; consumer owned
+
+public:
+	spsc_ring_t() : head(0), tail(0) {}
+
+	/**
+	 * producer side: append v. returns false if the ring is full.
+	 * */
+	bool push(const T &v)
+	{
+		uint8_t h = head;
+		if((uint8_t)(h - tail) == N) return false;
+		buf[h & (N - 1)] = v;
+		__asm__ __volatile__("" ::: "memory"); // store the element before publishing it
+		head = h + 1;
+		return true;
+	}
+
+	/**
+	 * consumer side: take the oldest element. returns false if the ring is empty.
+	 * */
+	bool pop(T &v)
+	{
+		uint8_t t = tail;
+		if(t == head) return false;
+		__asm__ __volatile__("" ::: "memory"); // read the element after seeing it published
+		v = buf[t & (N - 1)];
+		__asm__ __volatile__("" ::: "memory");
+		tail = t + 1;
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include <math.h>
+#include "thermal_monitor.h"
+
+#define BLOCK_SECS (THERMAL_MONITOR_BLOCK_MS * 0.001f)
+
+void thermal_monitor_t::reset()
+{
+	prev_temp = 0;
+	window_t0 = 0;
+	window_power = 0;
+	window_blocks = 0;
+	prev_window_unpowered = false;
+	heating_t0 = 0;
+	heating_power = 0;
+	heating_windows = 0;
+	rate_count = 0;
+	stuck_count = 0;
+	primed = false;
+}
+
+thermal_fault_t thermal_monitor_t::update(float temp, float env, float power)
+{
+	if(!primed)
+	{
+		primed = true;
+		prev_temp = window_t0 = temp;
+		return THERMAL_OK;
+	}
+
+	// rate of change
+	float delta = temp - prev_temp;
+	if(fabsf(delta) > max_rate * BLOCK_SECS)
+	{
+		if(++rate_count >= MONITOR_RATE_BLOCKS) return THERMAL_RATE;
+	}
+	else
+		rate_count = 0;
+
+	// stuck reading while the model says it should move
+	float expected_slope = (env + gain * power - temp) / tau; // deg C per second
+	if(delta == 0 && fabsf(expected_slope) * (MONITOR_STUCK_BLOCKS * BLOCK_SECS) > MONITOR_STUCK_MIN_MOVE)
+	{
+		if(++stuck_count >= MONITOR_STUCK_BLOCKS) return THERMAL_STUCK;
+	}
+	else
+		stuck_count = 0;
+
+	prev_temp = temp;
+
+	// response over the window
+	window_power += power;
+	if(++window_blocks < MONITOR_WINDOW_BLOCKS) return THERMAL_OK;
+
+	thermal_fault_t fault = THERMAL_OK;
+	float avg_power = window_power * (1.0f / MONITOR_WINDOW_BLOCKS);
+	float rise = temp - window_t0;
+	if(avg_power >= MONITOR_HEATING_POWER)
+	{
+		if(!heating_windows)
+		{
+			heating_t0 = window_t0;
+			heating_power = 0;
+		}
+		if(heating_windows < UINT16_MAX) ++heating_windows;
+		heating_power += window_power;
+
+		// rise since heating started against the model, both from heating_t0
+		float t = heating_windows * (MONITOR_WINDOW_BLOCKS * BLOCK_SECS) - dead_time;
+		if(t > 0)
+		{
+			float power = heating_power * (1.0f / MONITOR_WINDOW_BLOCKS) / heating_windows;
+			float expected_rise = (env + gain * power - heating_t0) * (1.0f - expf(-t / tau));
+			if(expected_rise >= MONITOR_MIN_EXPECTED_RISE && temp - heating_t0 < expected_rise * MONITOR_RISE_TOLERANCE)
+				fault = THERMAL_NO_RISE;
+		}
+	}
+	else
+		heating_windows = 0;
+	bool unpowered = window_power == 0;
+	if(unpowered && prev_window_unpowered && rise > MONITOR_RUNAWAY_RISE)
+		fault = THERMAL_RUNAWAY;
+
+	prev_window_unpowered = unpowered;
+	window_t0 = temp;
+	window_power = 0;
+	window_blocks = 0;
+	return fault;
+}
+
+uint32_t thermal_monitor_t::no_rise_latency_ms(float t0, float env, float power) const
+{
+	float headroom = env + gain * power - t0; // final model rise
+	if(headroom <= MONITOR_MIN_EXPECTED_RISE) return UINT32_MAX;
+	float secs = dead_time + tau * logf(headroom / (headroom - MONITOR_MIN_EXPECTED_RISE));
+	return (uint32_t)ceilf(secs * 1000) + 2 * THERMAL_MONITOR_WINDOW_MS;
+}
@@ -0,0 +1,121 @@
+#ifndef THERMAL_MONITOR_H__
+#define THERMAL_MONITOR_H__
+
+#include <stdint.h>
+
+/*
+	Model-based thermal fault detector for one sensor.
+
+	Once per oversample block the monitor is given the sensor temperature,
+	the environment temperature and the heater power applied during that
+	block. The model is a lower bound on a healthy response: after dead_time
+	of heating the temperature rises at least like
+	  T(t) = Tss + (T0 - Tss) * exp(-(t - dead_time) / tau),  Tss = Tenv + gain * power
+	For the element gain and tau come from its capacity and its conductance
+	to the air; for the air sensor gain takes the losses to the environment
+	and to a cold load, and dead_time covers the element and sensor lags.
+	The monitor reports:
+
+	- THERMAL_RATE: the reading moved faster than max_rate for
+	  MONITOR_RATE_BLOCKS blocks in a row (intermittent or detached sensor).
+	- THERMAL_STUCK: the reading stayed bit-identical for MONITOR_STUCK_BLOCKS
+	  blocks although the model says it should have moved by more than
+	  MONITOR_STUCK_MIN_MOVE.
+	- THERMAL_NO_RISE: while heating, i.e. in consecutive windows of
+	  MONITOR_WINDOW_BLOCKS at an average power of at least
+	  MONITOR_HEATING_POWER, the rise since heating started was below
+	  MONITOR_RISE_TOLERANCE of the model rise (heater failure, or a sensor
+	  detached from what it measures). Model rises below
+	  MONITOR_MIN_EXPECTED_RISE are not checked.
+	- THERMAL_RUNAWAY: the temperature rose by more than MONITOR_RUNAWAY_RISE
+	  over a window following another window with no heater power at all.
+
+	Each fault has its own worst case latency from its onset until it is
+	reported: THERMAL_RATE_LATENCY_MS, THERMAL_STUCK_LATENCY_MS and
+	THERMAL_RUNAWAY_LATENCY_MS are fixed; no_rise_latency_ms() adds the dead
+	time and the time the model rise takes to reach MONITOR_MIN_EXPECTED_RISE,
+	which depend on the monitor and on where heating starts.
+	tools/sweep/oven_model.h is the reference plant: test/ runs the monitors
+	through whole programs on it, healthy and with injected faults.
+*/
+
+#define THERMAL_MONITOR_BLOCK_MS 256 // update interval; one oversample block
+#define MONITOR_RATE_BLOCKS 2
+#define MONITOR_STUCK_BLOCKS 16
+#define MONITOR_STUCK_MIN_MOVE 3.0f // deg C
+#define MONITOR_WINDOW_BLOCKS 40
+#define MONITOR_HEATING_POWER 0.5f // fraction of full power
+#define MONITOR_MIN_EXPECTED_RISE 10.0f // deg C; smaller model rises are not checked
+#define MONITOR_RISE_TOLERANCE 0.25f
+#define MONITOR_RUNAWAY_RISE 15.0f // deg C
+
+#define THERMAL_MONITOR_WINDOW_MS ((uint32_t)MONITOR_WINDOW_BLOCKS * THERMAL_MONITOR_BLOCK_MS)
+
+// worst case time from the onset of a fault until it is reported
+#define THERMAL_RATE_LATENCY_MS ((uint32_t)MONITOR_RATE_BLOCKS * THERMAL_MONITOR_BLOCK_MS)
+// the block that takes the frozen reading, then MONITOR_STUCK_BLOCKS repeats
+#define THERMAL_STUCK_LATENCY_MS ((MONITOR_STUCK_BLOCKS + 1UL) * THERMAL_MONITOR_BLOCK_MS)
+// the window in progress at onset, then a whole unpowered window rising by
+// more than MONITOR_RUNAWAY_RISE
+#define THERMAL_RUNAWAY_LATENCY_MS (2 * THERMAL_MONITOR_WINDOW_MS)
+
+enum thermal_fault_t : uint8_t
+{
+	THERMAL_OK,
+	THERMAL_RATE,
+	THERMAL_STUCK,
+	THERMAL_NO_RISE,
+	THERMAL_RUNAWAY,
+};
+
+class thermal_monitor_t
+{
+public:
+	float gain; //!< steady-state rise above environment at full power, deg C
+	float tau; //!< time constant, seconds
+	float dead_time; //!< seconds of heating before the temperature has to respond
+	float max_rate; //!< largest plausible rate of change, deg C per second
+
+private:
+	float prev_temp;
+	float window_t0; //!< temperature at the window start
+	float window_power; //!< sum of power in the window
+	uint8_t window_blocks;
+	bool prev_window_unpowered;
+	float heating_t0; //!< temperature when heating started
+	float heating_power; //!< sum of power since heating started
+	uint16_t heating_windows; //!< windows since heating started; 0 when not heating
+	uint8_t rate_count;
+	uint8_t stuck_count;
+	bool primed; //!< prev_temp is valid
+
+public:
+	thermal_monitor_t(float gain_, float tau_, float dead_time_, float max_rate_) :
+		gain(gain_), tau(tau_), dead_time(dead_time_), max_rate(max_rate_)
+	{
+		reset();
+	}
+
+	/**
+	 * forget history, e.g. after the model has been changed
+	 * */
+	void reset();
+
+	/**
+	 * Feed one block. power is the heater power applied during the block,
+	 * 0 to 1. Returns the detected fault, if any.
+	 * */
+	thermal_fault_t update(float temp, float env, float power);
+
+	/**
+	 * Worst case time from the start of heating at power, from temperature t0,
+	 * until THERMAL_NO_RISE is reported for a sensor that does not respond:
+	 * the dead time, the time the model rise takes to reach
+	 * MONITOR_MIN_EXPECTED_RISE, one window for heating to line up with the
+	 * windows and one for the check at the window end. UINT32_MAX if the model
+	 * rise never gets there.
+	 * */
+	uint32_t no_rise_latency_ms(float t0, float env, float power) const;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "thermistor_fx.h"
+
+#define LOG2_TABLE_BITS 5
+#define LN2_Q12 2839 // ln(2) * 4096
+
+// log2(1 + i / 32) * 4096
+static const uint16_t log2_table[(1 << LOG2_TABLE_BITS) + 1] PROGMEM =
+{
+	0, 182, 358, 530, 696, 858, 1016, 1169, 1319, 1465, 1607, 1746, 1882, 2015, 2145, 2272,
+	2396, 2518, 2637, 2754, 2869, 2982, 3092, 3200, 3307, 3412, 3514, 3615, 3715, 3812, 3908, 4003,
+	4096,
+};
+
+// log2(x) in Q12, x > 0
+static int32_t log2_q12(uint32_t x)
+{
+	int8_t e = 31;
+	while(!(x & 0x80000000ul))
+	{
+		x <<= 1;
+		--e;
+	}
+	// x is now 1.f with 31 fraction bits
+	uint8_t idx = (x >> (31 - LOG2_TABLE_BITS)) & ((1 << LOG2_TABLE_BITS) - 1);
+	uint16_t rem = x >> (31 - LOG2_TABLE_BITS - 16);
+	uint16_t a = pgm_read_word(&log2_table[idx]);
+	uint16_t b = pgm_read_word(&log2_table[idx + 1]);
+	return ((int32_t)e << THERMISTOR_FX_Q) + a + (uint16_t)(((uint32_t)(b - a) * rem) >> 16);
+}
+
+temp_fx_t thermistor_fx_t::convert(uint32_t reading, uint32_t full_scale) const
+{
+	// ln(n / (1 - n)) = ln2 * (log2(reading) - log2(full_scale - reading))
+	int32_t l = log2_q12(reading) - log2_q12(full_scale - reading);
+	int32_t d = offset + ((l * LN2_Q12) >> THERMISTOR_FX_Q);
+	if(d <= 0) return TEMP_FX_MAX; // beyond the model; far above any limit
+
+	int32_t t = numerator / d - (int32_t)(273.15f * TEMP_FX_ONE + 0.5f);
+	if(t > TEMP_FX_MAX) t = TEMP_FX_MAX;
+	return (temp_fx_t)t;
+}
+
+void temp_fx_print(temp_fx_t t)
+{
+	uint16_t a = t;
+	if(t < 0)
+	{
+		Serial.print('-');
+		a = -t;
+	}
+	Serial.print(a >> TEMP_FX_SHIFT);
+	Serial.print('.');
+	uint8_t frac = ((a & (TEMP_FX_ONE - 1)) * 100 + TEMP_FX_ONE / 2) >> TEMP_FX_SHIFT;
+	if(frac < 10) Serial.print('0');
+	Serial.print(frac);
+}
+
+#if FIXED_POINT_TEMPS
+
+char *real_format(float v, uint8_t decimals, char *buf)
+{
+	// the steps of Print::printFloat, so both builds print the same text
+	if(isnan(v)) return strcpy_P(buf, PSTR("nan"));
+	if(isinf(v)) return strcpy_P(buf, PSTR("inf"));
+	if(v > 4294967040.0f || v < -4294967040.0f) return strcpy_P(buf, PSTR("ovf"));
+
+	char *p = buf;
+	if(v < 0)
+	{
+		*p++ = '-';
+		v = -v;
+	}
+	float rounding = 0.5f;
+	for(uint8_t i = 0; i < decimals; ++i) rounding /= 10;
+	v += rounding;
+
+	uint32_t int_part = (uint32_t)v;
+	float remainder = v - int_part;
+	ultoa(int_part, p, 10);
+	p += strlen(p);
+	if(decimals) *p++ = '.';
+	while(decimals--)
+	{
+		remainder *= 10;
+		uint8_t digit = (uint8_t)remainder;
+		*p++ = '0' + digit;
+		remainder -= digit;
+	}
+	*p = 0;
+	return buf;
+}
+
+void real_print(float v)
+{
+	char buf[REAL_FORMAT_SIZE];
+	Serial.print(real_format(v, 2, buf));
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef THERMISTOR_FX_H__
+#define THERMISTOR_FX_H__
+
+#include <stdint.h>
+
+/*
+	Integer temperature pipeline for the FIXED_POINT_TEMPS build.
+
+	The B-parameter thermistor equation
+	  1/T = 1/T0 + ln(R / R0) / B,  R = RP * n / (1 - n)
+	is evaluated as T = B / (B / T0 + ln(RP / R0) + ln(n / (1 - n))) with
+	ln taken from an integer log2 of the ADC sum and of its complement, so
+	the 1 ms sampling and the block conversion need no floating point. The
+	constants are folded by the compiler from the float thermistor
+	parameters. Resolution is 1/TEMP_FX_ONE deg C; the log2 table keeps the
+	conversion within 0.15 deg C of the float one up to 1050 deg C.
+
+	Scope of the build: the 1 ms sampling, the timer1 PWM interrupt and the
+	power slew use no floating point, and the float printing code is not
+	linked. The block-rate code, 4 times a second, stays float: the PID
+	controllers, the FOPDT models, the thermal monitors, the feed-forward
+	tables and the f32 parameters, so soft-float arithmetic is still linked.
+*/
+
+#ifndef FIXED_POINT_TEMPS
+#define FIXED_POINT_TEMPS 0
+#endif
+
+typedef int16_t temp_fx_t; //!< deg C * TEMP_FX_ONE
+
+#define TEMP_FX_SHIFT 4
+#define TEMP_FX_ONE (1 << TEMP_FX_SHIFT)
+#define TEMP_FX_MAX INT16_MAX
+#define THERMISTOR_FX_Q 12 // fraction bits of the log domain
+
+class thermistor_fx_t
+{
+	int32_t offset; //!< B / T0 + ln(RP / R0), Q12
+	int32_t numerator; //!< B * TEMP_FX_ONE, Q12
+
+public:
+	constexpr thermistor_fx_t(float t0, float b, float r0, float rp) :
+		offset((int32_t)((b / t0 + __builtin_log(rp / r0)) * (1L << THERMISTOR_FX_Q) + 0.5f)),
+		numerator((int32_t)(b * TEMP_FX_ONE * (1L << THERMISTOR_FX_Q))) {}
+
+	/**
+	 * Temperature for the normalized reading n = reading / full_scale,
+	 * 0 < reading < full_scale. A shorted sensor reads TEMP_FX_MAX.
+	 * */
+	temp_fx_t convert(uint32_t reading, uint32_t full_scale) const;
+};
+
+/**
+ * print a temperature like Serial.print(float) does
+ * */
+void temp_fx_print(temp_fx_t t);
+
+/*
+	Printing of the remaining float values (set points, energy, models, PID
+	state, menu editors). The FIXED_POINT_TEMPS build formats them with
+	integer digits, so Print::printFloat and dtostrf are not linked; the
+	float build uses them as before.
+*/
+
+#define REAL_FORMAT_SIZE 17 // "-4294967040.0000" and the NUL
+
+#if FIXED_POINT_TEMPS
+
+/**
+ * Format v with decimals (0 to 4) places into buf of REAL_FORMAT_SIZE
+ * bytes, exactly as Serial.print(v, decimals) does. Returns buf.
+ * */
+char *real_format(float v, uint8_t decimals, char *buf);
+
+/**
+ * print v with two places like Serial.print(float) does
+ * */
+void real_print(float v);
+
+#define FORMAT_REAL(v, decimals, buf) real_format(v, decimals, buf)
+#define PRINT_REAL(v) real_print(v)
+
+#else
+
+#define FORMAT_REAL(v, decimals, buf) dtostrf(v, 0, decimals, buf)
+#define PRINT_REAL(v) Serial.print(v)
+
+#endif
+
+#endif
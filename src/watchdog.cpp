@@ -0,0 +1,164 @@
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+#include "watchdog.h"
+#include "eeprom_layout.h"
+
+/*
+	EEPROM record: wdt_resets:u8 last_stalled_task:u8 last_reset_flags:u8.
+	Erased EEPROM (0xff) reads as no watchdog reset yet.
+*/
+
+static_assert(3 <= EEPROM_WATCHDOG_SIZE, "watchdog record too large");
+
+#define WDT_RESETS_ADDR ((uint8_t *)(uintptr_t)EEPROM_WATCHDOG_ADDR)
+#define WDT_STALLED_ADDR ((uint8_t *)(uintptr_t)(EEPROM_WATCHDOG_ADDR + 1))
+#define WDT_FLAGS_ADDR ((uint8_t *)(uintptr_t)(EEPROM_WATCHDOG_ADDR + 2))
+
+#define WDT_BLAME_MAGIC 0x5a
+
+static const uint16_t deadlines[WDT_NUM_TASKS] PROGMEM =
+{
+	WDT_DEADLINE_TEMP,
+	WDT_DEADLINE_UI,
+	WDT_DEADLINE_TIMER,
+	WDT_DEADLINE_PROG,
+};
+
+static_assert(WDT_NUM_TASKS <= 8, "idle tasks are bits of a byte");
+
+static uint32_t last_checkin[WDT_NUM_TASKS]; // millis() of the last heartbeat
+static uint8_t idle_tasks; // bit per task not supervised until it checks in
+static bool running;
+
+// these survive the watchdog reset; .bss is cleared after .init3 runs
+static uint8_t reset_flags __attribute__((section(".noinit")));
+static uint8_t blame __attribute__((section(".noinit")));
+static uint8_t blame_check __attribute__((section(".noinit"))); // blame ^ WDT_BLAME_MAGIC
+
+/**
+ * Capture the reset cause and stop the WDT before the C runtime initialises
+ * RAM; after a watchdog reset the WDT stays enabled at its shortest timeout.
+ * Optiboot clears MCUSR itself and passes the flags in r2; see watchdog.h.
+ * */
+void watchdog_early_init() __attribute__((naked, used, section(".init3")));
+void watchdog_early_init()
+{
+	__asm__ __volatile__("sts %0, r2" : "=m"(reset_flags));
+	reset_flags |= MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+}
+
+/**
+ * the task whose heartbeat is most overdue, or WDT_TASK_NONE
+ * */
+static uint8_t most_overdue()
+{
+	uint32_t now = millis();
+	uint8_t worst = WDT_TASK_NONE;
+	int32_t worst_late = 0;
+	for(uint8_t i = 0; i < WDT_NUM_TASKS; ++i)
+	{
+		uint32_t last;
+		bool idle;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			last = last_checkin[i];
+			idle = idle_tasks & _BV(i);
+		}
+		if(idle) continue;
+		int32_t late = (int32_t)(now - last) - (int32_t)pgm_read_word(deadlines + i);
+		if(late > worst_late)
+		{
+			worst_late = late;
+			worst = i;
+		}
+	}
+	return worst;
+}
+
+void watchdog_init()
+{
+	if(reset_flags & _BV(WDRF))
+	{
+		uint8_t task = (blame ^ WDT_BLAME_MAGIC) == blame_check ? blame : (uint8_t)WDT_TASK_NONE;
+		uint8_t count = eeprom_read_byte(WDT_RESETS_ADDR);
+		if(count == 0xff) count = 0;
+		if(count < 0xfe) ++count;
+		eeprom_update_byte(WDT_STALLED_ADDR, task);
+		eeprom_update_byte(WDT_FLAGS_ADDR, reset_flags);
+		eeprom_update_byte(WDT_RESETS_ADDR, count);
+	}
+	blame = WDT_TASK_NONE;
+	blame_check = 0;
+
+	uint32_t now = millis();
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		for(uint8_t i = 0; i < WDT_NUM_TASKS; ++i)
+			last_checkin[i] = now;
+
+		// interrupt and reset mode, 2 s
+		wdt_reset();
+		WDTCSR = _BV(WDCE) | _BV(WDE);
+		WDTCSR = _BV(WDIE) | _BV(WDE) | _BV(WDP2) | _BV(WDP1) | _BV(WDP0);
+	}
+	running = true;
+}
+
+void watchdog_checkin(uint8_t task)
+{
+	uint32_t now = millis();
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		last_checkin[task] = now;
+		idle_tasks &= ~_BV(task);
+	}
+}
+
+void watchdog_idle(uint8_t task)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { idle_tasks |= _BV(task); }
+}
+
+void watchdog_poll()
+{
+	if(!running) return;
+	if(most_overdue() == WDT_TASK_NONE)
+		wdt_reset();
+}
+
+void watchdog_stop()
+{
+	running = false;
+	wdt_disable();
+}
+
+void watchdog_get_reset_info(watchdog_reset_info_t &info)
+{
+	info.reset_flags = reset_flags;
+	info.wdt_resets = eeprom_read_byte(WDT_RESETS_ADDR);
+	if(info.wdt_resets == 0xff)
+	{
+		info.wdt_resets = 0;
+		info.last_stalled_task = WDT_TASK_NONE;
+		info.last_reset_flags = 0;
+	}
+	else
+	{
+		info.last_stalled_task = eeprom_read_byte(WDT_STALLED_ADDR);
+		info.last_reset_flags = eeprom_read_byte(WDT_FLAGS_ADDR);
+	}
+}
+
+ISR(WDT_vect)
+{
+	watchdog_expired();
+	uint8_t task = most_overdue();
+	blame = task;
+	blame_check = task ^ WDT_BLAME_MAGIC;
+	// WDIE has been cleared by the hardware; the next expiry resets
+	for(;;) {}
+}
@@ -0,0 +1,106 @@
+#ifndef WATCHDOG_H__
+#define WATCHDOG_H__
+
+#include <stdint.h>
+
+/*
+	Per-task software watchdog backed by the hardware WDT.
+
+	Every supervised task calls watchdog_checkin() each time it makes
+	progress: completes a cycle, or evaluates the condition it is waiting on.
+	A task with nothing to do calls watchdog_idle() and is not supervised
+	until its next check-in. watchdog_poll(), called from the main loop, feeds
+	the WDT only while every task has checked in within its deadline, so a
+	hung task or a hung main loop both let the WDT expire.
+
+	The main loop must never block for longer than WDT_MAX_BLOCKING_MS at
+	once: manage_temp() needs an oversample block on top of that to check in.
+	Long serial output is therefore streamed a row at a time as the transmit
+	buffer drains, and slow EEPROM writes (params_commit(), history_flush();
+	about 3.4 ms per changed byte) run one per loop pass.
+
+	The WDT runs in interrupt-and-reset mode: the first expiry calls
+	watchdog_expired() to make the hardware safe and records the task whose
+	heartbeat is most overdue, then spins until the second expiry resets the
+	MCU. The reset cause and the stalled task are kept in EEPROM for
+	post-mortem, so they survive the reset caused by opening the serial port.
+
+	Requires Optiboot (board nanoatmega328new in platformio.ini). It disables
+	the WDT on its way out and hands the reset cause over in r2 after
+	clearing MCUSR. The old ATmegaBOOT of Nano boards does neither: a
+	watchdog reset would loop in the bootloader, and reset flags would read
+	as whatever r2 happened to hold.
+*/
+
+enum watchdog_task_t : uint8_t
+{
+	WDT_TASK_TEMP, //!< manage_temp()
+	WDT_TASK_UI, //!< UI coroutine
+	WDT_TASK_TIMER, //!< timer1 interrupt (heater PWM)
+	WDT_TASK_PROG, //!< program runner coroutine, while a program runs
+
+	WDT_NUM_TASKS,
+	WDT_TASK_NONE = 0xff
+};
+
+// heartbeat deadlines, ms
+#define WDT_DEADLINE_TEMP 1000
+#define WDT_DEADLINE_UI 1000
+#define WDT_DEADLINE_TIMER 100
+#define WDT_DEADLINE_PROG 1000
+
+#define WDT_MAX_BLOCKING_MS 700 // longest the main loop may block at once
+#define WDT_EEPROM_BYTE_MS 4 // worst case for one EEPROM byte write, rounded up
+
+/**
+ * post-mortem record; also the CMD_GET_RESET_INFO reply data
+ * */
+struct __attribute__((packed)) watchdog_reset_info_t
+{
+	uint8_t reset_flags; //!< MCUSR flags of the current boot
+	uint8_t wdt_resets; //!< number of watchdog resets so far, saturating
+	uint8_t last_stalled_task; //!< task blamed for the latest watchdog reset, or WDT_TASK_NONE
+	uint8_t last_reset_flags; //!< MCUSR flags of the boot after the latest watchdog reset
+};
+
+/**
+ * Record the post-mortem of the previous reset and start the hardware WDT.
+ * Call once at the end of setup(), when every task is about to run.
+ * */
+void watchdog_init();
+
+/**
+ * Heartbeat of a task; may be called from an interrupt handler
+ * */
+void watchdog_checkin(uint8_t task);
+
+/**
+ * Stop supervising a task until its next watchdog_checkin(), e.g. while it
+ * has nothing to do
+ * */
+void watchdog_idle(uint8_t task);
+
+/**
+ * Check the heartbeats and feed the WDT if every task is alive.
+ * Call from the main loop.
+ * */
+void watchdog_poll();
+
+/**
+ * Stop the hardware WDT, e.g. before halting deliberately
+ * */
+void watchdog_stop();
+
+/**
+ * Post-mortem of the current boot
+ * */
+void watchdog_get_reset_info(watchdog_reset_info_t &info);
+
+/**
+ * Called from the WDT interrupt shortly before the reset; implemented by the
+ * application to put the hardware into a safe state. Interrupts are disabled
+ * and stay so until the reset.
+ * */
+void watchdog_expired();
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef CHECK_H__
+#define CHECK_H__
+
+#include <stdio.h>
+
+/*
+	Minimal assertions for the host tests: a failed CHECK prints where and
+	what, and makes check_result() return non-zero for main().
+*/
+
+static int check_failures;
+
+#define CHECK(cond, ...) do { \
+		if(!(cond)) \
+		{ \
+			++check_failures; \
+			printf("%s:%d: %s: ", __FILE__, __LINE__, #cond); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+		} \
+	} while(0)
+
+static int check_result(const char *name)
+{
+	printf("%s: %s\n", name, check_failures ? "FAILED" : "ok");
+	return check_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,118 @@
+/*
+	History ring: the dump stream must decode to the recorded samples, also
+	when the records wrap around the end of the ring.
+*/
+
+#include "check.h"
+#include "history.h"
+
+#define INTERVAL_SECS 1.0f
+#define BLOCKS_PER_SAMPLE 4 // 4 blocks of 256 ms reach one second
+
+static uint8_t dump[HISTORY_HEADER_SIZE + HISTORY_SIZE];
+static uint16_t dump_len;
+
+// read the dump in small pieces, as CMD_GET_HISTORY does
+static void read_dump()
+{
+	dump_len = history_dump_length();
+	CHECK(dump_len <= sizeof(dump), "dump of %u bytes", dump_len);
+	for(uint16_t offset = 0; offset < dump_len; )
+		offset += history_dump(offset, dump + offset, 7);
+}
+
+static int16_t get16(const uint8_t *p)
+{
+	return (int16_t)(p[0] | p[1] << 8);
+}
+
+static int32_t zigzag(const uint8_t *&p)
+{
+	uint16_t z = 0;
+	for(uint8_t shift = 0; ; shift += 7)
+	{
+		uint8_t c = *p++;
+		z |= (uint16_t)(c & 0x7f) << shift;
+		if(!(c & 0x80)) break;
+	}
+	return (int16_t)((z >> 1) ^ -(z & 1));
+}
+
+/**
+ * Decode the dump into samples; returns their count. Restarts are skipped.
+ * */
+static int decode_dump(history_sample_t *out, int max)
+{
+	history_sample_t s;
+	for(uint8_t i = 0; i < HISTORY_FIELDS; ++i) s.v[i] = get16(dump + 4 + 2 * i);
+
+	int n = 0;
+	for(const uint8_t *p = dump + HISTORY_HEADER_SIZE; p < dump + dump_len; )
+	{
+		uint8_t b = *p++;
+		int run = 1;
+		if(b == 0x00)
+			run = 0;
+		else if(b & 0x80)
+			run = (b & 0x7f) + 1;
+		else
+			for(uint8_t i = 0; i < HISTORY_FIELDS; ++i)
+				if(b & (1 << i)) s.v[i] += zigzag(p);
+		while(run-- && n < max) out[n++] = s;
+	}
+	return n;
+}
+
+// a sample that changes every field, so every record is a few bytes long
+static void expected(int i, history_sample_t &s)
+{
+	s.v[HISTORY_HEATER_TEMP] = 100 + (i * 37) % 300;
+	s.v[HISTORY_AIR_TEMP] = 50 + (i * 11) % 120;
+	s.v[HISTORY_HEATER_SET_POINT] = i % 2 ? 250 : 0;
+	s.v[HISTORY_AIR_SET_POINT] = 150 + i % 7;
+	s.v[HISTORY_POWER] = i % (HISTORY_POWER_STEPS + 1);
+}
+
+static void add_sample(int i)
+{
+	history_sample_t s;
+	expected(i, s);
+	for(uint8_t b = 0; b < BLOCKS_PER_SAMPLE; ++b)
+		history_add(s.v[HISTORY_HEATER_TEMP], s.v[HISTORY_AIR_TEMP], s.v[HISTORY_HEATER_SET_POINT],
+			s.v[HISTORY_AIR_SET_POINT], s.v[HISTORY_POWER] * (1.0f / HISTORY_POWER_STEPS), INTERVAL_SECS);
+}
+
+// after each sample the dump holds the newest samples, oldest first
+static void check_tail(int added)
+{
+	static history_sample_t got[HISTORY_SIZE * HISTORY_RUN_MAX];
+	read_dump();
+	int n = decode_dump(got, sizeof(got) / sizeof(got[0]));
+	CHECK(n > 0 && n <= added, "%d samples decoded after %d", n, added);
+	for(int k = 0; k < n; ++k)
+	{
+		history_sample_t s;
+		expected(added - n + k, s);
+		for(uint8_t i = 0; i < HISTORY_FIELDS; ++i)
+			if(got[k].v[i] != s.v[i])
+			{
+				CHECK(got[k].v[i] == s.v[i], "after %d samples, sample %d field %d", added, added - n + k, i);
+				return;
+			}
+	}
+}
+
+int main()
+{
+	history_init();
+
+	// several times around the ring, so the dump wraps at every offset
+	for(int i = 0; i < 4 * HISTORY_SIZE; ++i)
+	{
+		add_sample(i);
+		check_tail(i + 1);
+	}
+	CHECK(history_dump_length() > HISTORY_HEADER_SIZE + HISTORY_SIZE / 2, "ring of %u bytes", history_dump_length());
+
+	return check_result("history");
+}
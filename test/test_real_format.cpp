@@ -0,0 +1,40 @@
+/*
+	Float formatting of the FIXED_POINT_TEMPS build: the output must match
+	what Serial.print(float, decimals) shows on the AVR, where double is
+	float.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "check.h"
+#include "thermistor_fx.h"
+
+static void expect(float v, uint8_t decimals, const char *text)
+{
+	char buf[REAL_FORMAT_SIZE];
+	real_format(v, decimals, buf);
+	CHECK(strcmp(buf, text) == 0, "%g with %d places: \"%s\", expected \"%s\"", v, decimals, buf, text);
+}
+
+int main()
+{
+	expect(0, 2, "0.00");
+	expect(-0.0f, 2, "0.00");
+	expect(160, 0, "160");
+	expect(12.345f, 2, "12.35");
+	expect(0.05f, 2, "0.05");
+	expect(-3.5f, 1, "-3.5");
+	expect(-0.004f, 2, "-0.00");
+	expect(1.9999f, 2, "2.00");
+	expect(5000, 4, "5000.0000");
+	expect(1e7f, 2, "10000000.00");
+	expect(-1.5e7f, 2, "-15000000.00");
+	expect(4e9f, 0, "4000000000");
+	expect(4294967040.0f, 0, "4294967040");
+	expect(4.3e9f, 2, "ovf");
+	expect(-4.3e9f, 2, "ovf");
+	expect(NAN, 2, "nan");
+	expect(-INFINITY, 1, "inf");
+
+	return check_result("real_format");
+}
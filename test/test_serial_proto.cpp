@@ -0,0 +1,86 @@
+/*
+	Frame parser: valid frames are dispatched, and no byte of a rejected
+	frame is left to the text commands.
+*/
+
+#include <Arduino.h>
+#include <util/crc16.h>
+#include "check.h"
+#include "serial_proto.h"
+
+static int dispatched;
+static uint8_t last_cmd;
+
+void serial_proto_dispatch(uint8_t cmd, const uint8_t *, uint8_t)
+{
+	++dispatched;
+	last_cmd = cmd;
+}
+
+// feed bytes 1 ms apart; returns how many were left to the text path
+static int feed(const uint8_t *p, int n)
+{
+	int text = 0;
+	for(int i = 0; i < n; ++i, ++host_millis)
+		if(!serial_proto_feed(p[i])) ++text;
+	return text;
+}
+
+// build a frame with LEN len, its CMD and ARGS all cmd; returns its size
+static int frame(uint8_t *buf, uint8_t len, uint8_t cmd)
+{
+	int n = 0;
+	uint16_t crc = 0xffff;
+	buf[n++] = SERIAL_PROTO_SYNC;
+	buf[n++] = len;
+	crc = _crc_xmodem_update(crc, len);
+	for(uint8_t i = 0; i < len; ++i)
+	{
+		buf[n++] = cmd;
+		crc = _crc_xmodem_update(crc, cmd);
+	}
+	buf[n++] = crc & 0xff;
+	buf[n++] = crc >> 8;
+	return n;
+}
+
+int main()
+{
+	uint8_t buf[300];
+	const uint8_t text[] = "p1\r\n";
+	int n;
+
+	// a valid frame is dispatched, and text around it passes through
+	CHECK(feed(text, 4) == 4, "text consumed");
+	n = frame(buf, 3, CMD_GET_STATUS);
+	CHECK(feed(buf, n) == 0 && dispatched == 1 && last_cmd == CMD_GET_STATUS, "valid frame");
+	CHECK(feed(text, 4) == 4, "text after a frame consumed");
+
+	// oversize: the payload is discarded up to the declared length
+	n = frame(buf, SERIAL_PROTO_MAX_PAYLOAD + 40, 'x');
+	CHECK(feed(buf, n) == 0 && dispatched == 1, "oversize frame leaked or dispatched");
+	CHECK(feed(text, 4) == 4, "text after an oversize frame consumed");
+
+	// LEN 0: only the CRC follows
+	n = frame(buf, 0, 'x');
+	CHECK(feed(buf, n) == 0 && dispatched == 1, "empty frame leaked or dispatched");
+	CHECK(feed(text, 4) == 4, "text after an empty frame consumed");
+
+	// too slow: the rest of the frame is discarded too
+	n = frame(buf, 20, 'x');
+	host_millis += 1;
+	CHECK(feed(buf, 10) == 0, "slow frame head leaked");
+	host_millis += SERIAL_PROTO_TIMEOUT_MS - 20;
+	CHECK(feed(buf + 10, n - 10) == 0 && dispatched == 1, "slow frame tail leaked or dispatched");
+	CHECK(feed(text, 4) == 4, "text after a slow frame consumed");
+
+	// a truncated frame ends when the line goes idle
+	n = frame(buf, SERIAL_PROTO_MAX_PAYLOAD + 40, 'x');
+	CHECK(feed(buf, 10) == 0, "truncated frame leaked");
+	host_millis += SERIAL_PROTO_TIMEOUT_MS + 1;
+	CHECK(feed(text, 4) == 4, "text after an idle line consumed");
+	n = frame(buf, 1, CMD_GET_PARAMS);
+	CHECK(feed(buf, n) == 0 && dispatched == 2 && last_cmd == CMD_GET_PARAMS, "frame after an idle line");
+
+	return check_result("serial_proto");
+}
@@ -0,0 +1,176 @@
+/*
+	Thermal monitors against the oven model.
+
+	The monitors are set up as in src/main.cpp and fed by a simulated cook of
+	each built-in program: a healthy oven must finish without a fault, and
+	each injected fault must be reported within the bound thermal_monitor.h
+	gives for it.
+*/
+
+#include <math.h>
+#include "builtin_programs.h"
+#include "check.h"
+#include "cook_sim.h"
+#include "thermal_monitor.h"
+
+#define ENV_TEMP 25.0f
+#define BLOCK_SECS (THERMAL_MONITOR_BLOCK_MS * 0.001f)
+#define NEVER 1e9f
+#define SENSOR_NOISE 0.1f // deg C peak, as in tools/sweep/cook_sim.cpp
+
+// the firmware defaults, as in src/main.cpp
+static const cook_params_t FIRMWARE = {30, 1, 600, 40, 90, 70, 1.5};
+
+enum fault_kind_t
+{
+	FAULT_NONE,
+	FAULT_HEATER_OPEN, //!< the element does not heat
+	FAULT_AIR_DETACHED, //!< the air sensor reads the room
+	FAULT_HEATER_STUCK, //!< the heater sensor reading freezes
+	FAULT_RELAY_WELDED, //!< the element stays at full power
+	FAULT_HEATER_LOOSE, //!< the heater sensor reading jumps back and forth
+};
+
+static float noise(uint32_t &seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return ((int32_t)(seed >> 8) * (1.0f / (1 << 23)) - 1.0f) * SENSOR_NOISE;
+}
+
+struct monitor_probe_t : cook_probe_t
+{
+	thermal_monitor_t heater_monitor{150, 100, 0, 20};
+	thermal_monitor_t air_monitor{120, 700, 60, 10};
+
+	fault_kind_t kind;
+	float onset; //!< s
+	float stuck_value = 0;
+	bool loose = false;
+	uint32_t seed = 1;
+	thermal_fault_t heater_fault = THERMAL_OK;
+	thermal_fault_t air_fault = THERMAL_OK;
+	float fault_time = NEVER; //!< first fault of either monitor
+	float heating_since = NEVER; //!< first block at or after onset at heating power
+	float heater_t0 = 0, air_t0 = 0; //!< readings at heating_since
+	float heating_power = 0; //!< sum of duty from heating_since until the fault
+	uint32_t heating_blocks = 0;
+
+	monitor_probe_t(fault_kind_t kind_, float onset_) : kind(kind_), onset(onset_) {}
+
+	void block(float t, float duty, oven_model_t &oven) override
+	{
+		bool active = kind != FAULT_NONE && t >= onset;
+		float heater_temp = oven.heater + noise(seed);
+		float air_temp = oven.air_sensor + noise(seed);
+		if(active)
+		{
+			switch(kind)
+			{
+			case FAULT_HEATER_OPEN:
+				// take back the heat the element got in this block
+				oven.heater -= 800 * duty * BLOCK_SECS / 400;
+				heater_temp = oven.heater + noise(seed);
+				break;
+			case FAULT_AIR_DETACHED:
+				air_temp = ENV_TEMP + noise(seed);
+				break;
+			case FAULT_HEATER_STUCK:
+				if(!stuck_value) stuck_value = heater_temp;
+				heater_temp = stuck_value;
+				break;
+			case FAULT_RELAY_WELDED:
+				oven.heater += 800 * (1 - duty) * BLOCK_SECS / 400;
+				heater_temp = oven.heater + noise(seed);
+				break;
+			case FAULT_HEATER_LOOSE:
+				loose = !loose;
+				if(loose) heater_temp += 100;
+				break;
+			default:;
+			}
+		}
+
+		if(active && duty >= MONITOR_HEATING_POWER && heating_since == NEVER)
+		{
+			heating_since = t;
+			heater_t0 = heater_temp;
+			air_t0 = air_temp;
+		}
+		if(heating_since != NEVER && fault_time == NEVER)
+		{
+			heating_power += duty;
+			++heating_blocks;
+		}
+
+		thermal_fault_t h = heater_monitor.update(heater_temp, ENV_TEMP, duty);
+		thermal_fault_t a = air_monitor.update(air_temp, ENV_TEMP, duty);
+		if(h && !heater_fault) heater_fault = h;
+		if(a && !air_fault) air_fault = a;
+		if((h || a) && fault_time == NEVER) fault_time = t;
+	}
+};
+
+static void healthy(const char *name, const uint16_t *prog)
+{
+	oven_model_params_t model;
+	monitor_probe_t probe(FAULT_NONE, 0);
+	cook_result_t res = simulate_cook(prog, FIRMWARE, model, &probe);
+	CHECK(res.finished, "%s did not finish", name);
+	CHECK(probe.fault_time == NEVER, "%s: false fault at %.1f s", name, probe.fault_time);
+}
+
+// first faults of both monitors, and the time from the fault injected at
+// onset until it was reported against the bound for the first fault
+static void inject(fault_kind_t kind, float onset, thermal_fault_t heater_fault, thermal_fault_t air_fault)
+{
+	oven_model_params_t model;
+	monitor_probe_t probe(kind, onset);
+	simulate_cook(PROG1.words, FIRMWARE, model, &probe);
+
+	CHECK(probe.heater_fault == heater_fault && probe.air_fault == air_fault,
+		"fault %d at %.0f s: heater fault %d air fault %d", kind, onset, probe.heater_fault, probe.air_fault);
+	if(probe.fault_time == NEVER) return;
+
+	// a heating failure has its onset when heating starts
+	float start = onset;
+	uint32_t bound;
+	switch(heater_fault ? heater_fault : air_fault)
+	{
+	case THERMAL_RATE:
+		bound = THERMAL_RATE_LATENCY_MS;
+		break;
+	case THERMAL_STUCK:
+		bound = THERMAL_STUCK_LATENCY_MS;
+		break;
+	case THERMAL_RUNAWAY:
+		bound = THERMAL_RUNAWAY_LATENCY_MS;
+		break;
+	default:
+		start = probe.heating_since;
+		float power = probe.heating_power / probe.heating_blocks;
+		bound = heater_fault ? probe.heater_monitor.no_rise_latency_ms(probe.heater_t0, ENV_TEMP, power)
+			: probe.air_monitor.no_rise_latency_ms(probe.air_t0, ENV_TEMP, power);
+	}
+	uint32_t detect_ms = (uint32_t)((probe.fault_time - start) * 1000 + 0.5f);
+	CHECK(detect_ms <= bound, "fault %d at %.0f s: reported after %lu ms, bound %lu ms",
+		kind, onset, (unsigned long)detect_ms, (unsigned long)bound);
+}
+
+int main()
+{
+	healthy("PROG1", PROG1.words);
+	healthy("PROG2", PROG2.words);
+
+	// PROG1 heats from cold to 160 deg C, dwells, cools down to 73 deg C for
+	// an hour and heats up again at about 5300 s
+	inject(FAULT_HEATER_OPEN, 0, THERMAL_NO_RISE, THERMAL_NO_RISE);
+	inject(FAULT_HEATER_OPEN, 5000, THERMAL_NO_RISE, THERMAL_NO_RISE);
+	inject(FAULT_AIR_DETACHED, 0, THERMAL_OK, THERMAL_NO_RISE);
+	inject(FAULT_AIR_DETACHED, 5000, THERMAL_OK, THERMAL_NO_RISE);
+	inject(FAULT_HEATER_STUCK, 0, THERMAL_STUCK, THERMAL_OK);
+	inject(FAULT_HEATER_LOOSE, 300, THERMAL_RATE, THERMAL_OK);
+	inject(FAULT_RELAY_WELDED, 1800, THERMAL_RUNAWAY, THERMAL_OK);
+	inject(FAULT_RELAY_WELDED, 3600, THERMAL_RUNAWAY, THERMAL_OK);
+
+	return check_result("thermal_monitor");
+}
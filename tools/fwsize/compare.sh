@@ -0,0 +1,40 @@
+#!/bin/sh
+# Compare the float firmware with the FIXED_POINT_TEMPS one: section sizes,
+# the soft-float support routines each links and the float printing code,
+# which the FIXED_POINT_TEMPS build should not link at all.
+#
+#   tools/fwsize/compare.sh            (from the repository root)
+#
+# CPU time is not measurable off the board. For that, flash each env built
+# with PLATFORMIO_BUILD_FLAGS=-DPROFILE_MANAGE_TEMP=1 and read the U: field
+# of the telemetry: mean us per 1 ms sample / us per control block.
+
+set -e
+
+ENVS="miniatmega328 miniatmega328_fixed"
+BIN=${AVR_TOOLCHAIN:-$HOME/.platformio/packages/toolchain-atmelavr/bin}
+
+# soft-float entry points of libgcc/libm, and the float printing of Print and avr-libc
+FLOAT_RE=' (__(add|sub|mul|div|cmp|unord|lt|le|gt|ge|eq|ne)sf[23]|__fix(uns)?sfsi|__float(un)?sisf|__fp_[a-z_]+|log|logf|exp|expf)$'
+PRINT_RE=' (dtostr[ef]|Print::printFloat.*)$'
+
+# bytes and count of the text symbols of $1 matching $2
+routines() {
+	bytes=0
+	count=0
+	for size in $("$BIN/avr-nm" -S -C "$1" | grep -E " [Tt] " | grep -E "$2" | awk 'NF>=4{print $2}'); do
+		bytes=$((bytes + 0x$size))
+		count=$((count + 1))
+	done
+	echo "$bytes $count"
+}
+
+pio run -e miniatmega328 -e miniatmega328_fixed > /dev/null
+
+printf "%-22s %7s %7s %7s %9s %8s %11s\n" env text data bss float_lib routines float_print
+for env in $ENVS; do
+	elf=.pio/build/$env/firmware.elf
+	set -- $("$BIN/avr-size" -A "$elf" | awk '$1==".text"{t=$2} $1==".data"{d=$2} $1==".bss"{b=$2} END{print t, d, b}')
+	set -- "$@" $(routines "$elf" "$FLOAT_RE") $(routines "$elf" "$PRINT_RE")
+	printf "%-22s %7s %7s %7s %9s %8s %11s\n" "$env" "$1" "$2" "$3" "$4" "$5" "$6"
+done
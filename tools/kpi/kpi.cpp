@@ -0,0 +1,134 @@
+/*
+	Control performance KPIs from oven telemetry.
+
+	Reads the text telemetry of manage_temp() (default) or a capture of
+	CMD_GET_STATUS reply frames (-b), splits it at every set point change of
+	the followed loop and prints one CSV row per segment: rise time, overshoot,
+	settling time, steady-state error, heater duty and time in the bang-bang
+	regime outside the PID effective range. Input is streamed in large blocks
+	with constant memory, so week-long logs are fine.
+
+	  make && ./kpi [options] [file...] > segments.csv
+
+	Text logs need the T: set point field; older logs are reported as a
+	single segment without set point KPIs.
+*/
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "segment_kpi.h"
+
+#define READ_SIZE (4 << 20)
+
+struct totals_t
+{
+	uint64_t segments;
+	double saturated_secs;
+};
+
+static void print_segment(const segment_kpi_t &k, void *ctx)
+{
+	totals_t &tot = *(totals_t *)ctx;
+	++tot.segments;
+	tot.saturated_secs += k.saturated_secs;
+	printf("%.1f,%.1f,%c,%.2f,%.2f,%.1f,%.2f,%.1f,%.3f,%.3f,%.1f,%llu\n",
+		k.start, k.duration, k.loop, k.from, k.set_point, k.rise_secs, k.overshoot,
+		k.settling_secs, k.ss_error, k.duty, k.saturated_secs, (unsigned long long)k.samples);
+}
+
+static void add_sample(const telemetry_sample_t &s, void *ctx)
+{
+	((kpi_tracker_t *)ctx)->add(s);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-b] [-i secs] [-t block_ms] [-w band] [-r range] [-m min_step] [file...]\n"
+		"  -b  input is binary status reply frames instead of text\n"
+		"  -i  polling interval of the status frames, s (1)\n"
+		"  -t  telemetry line interval, ms (256)\n"
+		"  -w  settling band, deg C (2)\n"
+		"  -r  PID effective range, deg C (40)\n"
+		"  -m  smallest step given a rise time, deg C (5)\n", name);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	kpi_options_t opt;
+	bool binary = false;
+	double interval = 1;
+	double block_ms = 256;
+
+	int c;
+	while((c = getopt(argc, argv, "bi:t:w:r:m:")) != -1)
+	{
+		switch(c)
+		{
+		case 'b': binary = true; break;
+		case 'i': interval = atof(optarg); break;
+		case 't': block_ms = atof(optarg); break;
+		case 'w': opt.band = atof(optarg); break;
+		case 'r': opt.effective_range = atof(optarg); break;
+		case 'm': opt.min_step = atof(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+
+	totals_t tot = {};
+	kpi_tracker_t tracker(opt, print_segment, &tot);
+	text_parser_t text(block_ms * 0.001, add_sample, &tracker);
+	frame_parser_t frames(interval, add_sample, &tracker);
+
+	printf("start_s,duration_s,loop,from_c,set_point_c,rise_s,overshoot_c,settling_s,ss_error_c,duty,bang_bang_s,samples\n");
+
+	char *buf = (char *)malloc(READ_SIZE);
+	uint64_t bytes = 0;
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	// files are concatenated into one stream; '-' or no file is stdin
+	for(int i = optind; i < argc || i == optind; ++i)
+	{
+		int fd = 0;
+		if(i < argc && strcmp(argv[i], "-"))
+		{
+			fd = open(argv[i], O_RDONLY);
+			if(fd < 0)
+			{
+				perror(argv[i]);
+				return 1;
+			}
+#ifdef POSIX_FADV_SEQUENTIAL
+			posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+		}
+		ssize_t n;
+		while((n = read(fd, buf, READ_SIZE)) > 0)
+		{
+			bytes += n;
+			if(binary)
+				frames.feed((const uint8_t *)buf, n);
+			else
+				text.feed(buf, n);
+		}
+		if(n < 0) perror(i < argc ? argv[i] : "stdin");
+		if(fd) close(fd);
+		if(i >= argc) break;
+	}
+	tracker.finish();
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+	fprintf(stderr, "%llu bytes, %llu samples, %llu segments, %.0f s bang-bang, %.0f MB/s\n",
+		(unsigned long long)bytes, (unsigned long long)(binary ? frames.samples() : text.samples()),
+		(unsigned long long)tot.segments, tot.saturated_secs, bytes / (secs > 0 ? secs : 1e-9) * 1e-6);
+	free(buf);
+	return 0;
+}
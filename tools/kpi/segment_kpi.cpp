@@ -0,0 +1,110 @@
+#include <math.h>
+#include "segment_kpi.h"
+
+void kpi_tracker_t::close()
+{
+	if(!active) return;
+	active = false;
+
+	k.duration = last_t + dt - k.start;
+	k.duty = k.samples ? (float)(duty_sum / k.samples / 256) : 0;
+	if(inside)
+	{
+		k.settling_secs = last_outside < 0 ? 0 : (float)(last_outside + dt - k.start);
+		k.ss_error = (float)(settled_error / settled_samples);
+	}
+	sink(k, ctx);
+}
+
+void kpi_tracker_t::add(const telemetry_sample_t &s)
+{
+	if(s.t > last_t) dt = s.t - last_t;
+
+	// followed loop; streams without set points are one segment
+	char loop;
+	float sp, temp;
+	if(isnan(s.air_set_point))
+		loop = 'A', sp = NAN, temp = s.air_temp;
+	else if(s.air_set_point > 0)
+		loop = 'A', sp = s.air_set_point, temp = s.air_temp;
+	else if(s.heater_set_point > 0)
+		loop = 'H', sp = s.heater_set_point, temp = s.heater_temp;
+	else
+	{
+		// idle
+		close();
+		last_t = s.t;
+		return;
+	}
+
+	if(active && (loop != k.loop || !(sp == k.set_point || (isnan(sp) && isnan(k.set_point)))))
+		close();
+
+	if(!active)
+	{
+		active = true;
+		k = segment_kpi_t();
+		k.start = s.t;
+		k.loop = loop;
+		k.from = temp;
+		k.set_point = sp;
+		k.rise_secs = NAN;
+		k.settling_secs = NAN;
+		k.ss_error = NAN;
+		direction = sp >= temp ? 1 : -1;
+		reached = false;
+		t10 = -1;
+		last_outside = -1;
+		inside = false;
+		settled_error = 0;
+		settled_samples = 0;
+		duty_sum = 0;
+	}
+
+	++k.samples;
+	duty_sum += s.heater_power;
+	last_t = s.t;
+	if(isnan(sp)) return;
+
+	float err = temp - sp;
+	float step = (sp - k.from) * direction;
+	float progress = (temp - k.from) * direction;
+
+	// rise time
+	if(step >= opt.min_step && isnan(k.rise_secs))
+	{
+		if(t10 < 0 && progress >= 0.1f * step) t10 = s.t;
+		if(t10 >= 0 && progress >= 0.9f * step) k.rise_secs = (float)(s.t - t10);
+	}
+
+	// overshoot
+	float excess = err * direction;
+	if(!reached && excess >= 0) reached = true;
+	if(reached && excess > k.overshoot) k.overshoot = excess;
+
+	// settling and steady-state error
+	if(fabsf(err) <= opt.band)
+	{
+		if(!inside)
+		{
+			inside = true;
+			settled_error = 0;
+			settled_samples = 0;
+		}
+		settled_error += err;
+		++settled_samples;
+	}
+	else
+	{
+		inside = false;
+		last_outside = s.t;
+	}
+
+	// bang-bang regime of the PID
+	if(fabsf(err) > opt.effective_range) k.saturated_secs += (float)dt;
+}
+
+void kpi_tracker_t::finish()
+{
+	close();
+}
@@ -0,0 +1,73 @@
+#ifndef SEGMENT_KPI_H__
+#define SEGMENT_KPI_H__
+
+#include <stdint.h>
+#include "telemetry_parser.h"
+
+/**
+ * control performance of one set point segment
+ * */
+struct segment_kpi_t
+{
+	double start; //!< seconds from the start of the stream
+	double duration;
+	char loop; //!< 'A' air or 'H' heater; the followed temperature
+	float from; //!< temperature at the start
+	float set_point;
+	float rise_secs; //!< 10% to 90% of the step; NAN for holds or if never reached
+	float overshoot; //!< largest excursion past the set point after reaching it, deg C
+	float settling_secs; //!< from the start until it stays within the band; NAN if it never does
+	float ss_error; //!< mean temperature - set point once settled; NAN if not settled
+	float duty; //!< mean heater duty, 0 to 1
+	float saturated_secs; //!< time with |error| beyond effective_range, where the PID is bang-bang
+	uint64_t samples;
+};
+
+struct kpi_options_t
+{
+	float band = 2; //!< settling band, deg C
+	float effective_range = 40; //!< PID effective range, deg C
+	float min_step = 5; //!< smaller set point changes are holds; no rise time
+};
+
+typedef void (*segment_sink_t)(const segment_kpi_t &k, void *ctx);
+
+/**
+ * Splits a sample stream into segments of constant set point of the followed
+ * loop (air if its set point is non-zero, else heater) and computes the KPIs
+ * of each in a single pass with constant memory.
+ * */
+class kpi_tracker_t
+{
+	kpi_options_t opt;
+	segment_sink_t sink;
+	void *ctx;
+
+	bool active; //!< a segment is open
+	segment_kpi_t k;
+	double last_t;
+	double dt; //!< sample interval estimate
+	float direction; //!< +1 heating step, -1 cooling step
+	bool reached; //!< the set point has been crossed
+	double t10; //!< time the 10% point was passed, or -1
+	double last_outside; //!< last time outside the band, or -1 if never
+	bool inside; //!< currently within the band
+	double settled_error; //!< sum of errors since the last entry into the band
+	uint64_t settled_samples;
+	double duty_sum;
+
+	void close();
+
+public:
+	kpi_tracker_t(const kpi_options_t &o, segment_sink_t sink_, void *ctx_) :
+		opt(o), sink(sink_), ctx(ctx_), active(false), last_t(0), dt(0) {}
+
+	void add(const telemetry_sample_t &s);
+
+	/**
+	 * close the open segment at the end of the stream
+	 * */
+	void finish();
+};
+
+#endif
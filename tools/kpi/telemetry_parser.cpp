@@ -0,0 +1,239 @@
+#include <math.h>
+#include <string.h>
+#include "telemetry_parser.h"
+
+/*
+	Both parsers are written for throughput: input is scanned in place with
+	memchr, numbers are converted by hand, and nothing is allocated per line.
+*/
+
+// parse [-]digits[.digits]; returns the end of the number, or nullptr
+static const char *parse_float(const char *p, const char *end, float &out)
+{
+	bool neg = false;
+	if(p < end && *p == '-')
+	{
+		neg = true;
+		++p;
+	}
+
+	uint32_t ip = 0;
+	int digits = 0;
+	while(p < end && (unsigned)(*p - '0') < 10)
+	{
+		if(++digits > 9) return nullptr;
+		ip = ip * 10 + (*p - '0');
+		++p;
+	}
+	float v = (float)ip;
+
+	if(p < end && *p == '.')
+	{
+		++p;
+		uint32_t frac = 0;
+		float scale = 1;
+		while(p < end && (unsigned)(*p - '0') < 10)
+		{
+			if(scale > 1e-8f)
+			{
+				frac = frac * 10 + (*p - '0');
+				scale *= 0.1f;
+			}
+			++digits;
+			++p;
+		}
+		v += (float)frac * scale;
+	}
+	if(digits == 0) return nullptr;
+	out = neg ? -v : v;
+	return p;
+}
+
+// parse <a>/<b>
+static const char *parse_pair(const char *p, const char *end, float &a, float &b)
+{
+	p = parse_float(p, end, a);
+	if(!p || p >= end || *p != '/') return nullptr;
+	return parse_float(p + 1, end, b);
+}
+
+void text_parser_t::parse_line(const char *p, const char *end)
+{
+	if(end - p < 3 || p[0] != 'H' || (unsigned)(p[1] - '0') >= 10) return;
+
+	telemetry_sample_t s;
+	s.t = blocks * block_secs;
+	++blocks;
+	s.heater_set_point = s.air_set_point = NAN;
+
+	float heater_sum = 0, target;
+	int heaters = 0;
+	bool have_air = false, have_env = false, have_power = false;
+	while(p < end)
+	{
+		while(p < end && (*p == ' ' || *p == '\r')) ++p;
+		const char *key = p;
+		while(p < end && *p != ':' && *p != ' ') ++p;
+		if(p >= end || *p != ':') break;
+		size_t key_len = p - key;
+		++p;
+
+		const char *next = nullptr;
+		float v;
+		if(key[0] == 'H' && key_len >= 2)
+		{
+			if((next = parse_float(p, end, v))) heater_sum += v, ++heaters;
+		}
+		else if(key_len == 1 && key[0] == 'A')
+		{
+			if((next = parse_float(p, end, s.air_temp))) have_air = true;
+		}
+		else if(key_len == 1 && key[0] == 'E')
+		{
+			if((next = parse_float(p, end, s.env_temp))) have_env = true;
+		}
+		else if(key_len == 1 && key[0] == 'P')
+		{
+			if((next = parse_pair(p, end, target, s.heater_power))) have_power = true;
+		}
+		else if(key_len == 1 && key[0] == 'T')
+		{
+			next = parse_pair(p, end, s.heater_set_point, s.air_set_point);
+		}
+		if(!next)
+		{
+			// unknown or unparsable value (nan, ovf); skip the token
+			next = p;
+			while(next < end && *next != ' ') ++next;
+		}
+		p = next;
+	}
+
+	if(!heaters || !have_air || !have_env || !have_power) return;
+	s.heater_temp = heater_sum / heaters;
+	sink(s, ctx);
+}
+
+void text_parser_t::feed(const char *buf, size_t len)
+{
+	const char *p = buf;
+	const char *end = buf + len;
+
+	if(carry_len)
+	{
+		const char *nl = (const char *)memchr(p, '\n', len);
+		size_t n = (nl ? nl : end) - p;
+		if(carry_len <= sizeof(carry))
+		{
+			if(carry_len + n <= sizeof(carry))
+				memcpy(carry + carry_len, p, n);
+			carry_len += n; // past sizeof(carry): too long for telemetry, dropped
+		}
+		if(!nl) return;
+		if(carry_len <= sizeof(carry)) parse_line(carry, carry + carry_len);
+		carry_len = 0;
+		p = nl + 1;
+	}
+
+	while(p < end)
+	{
+		const char *nl = (const char *)memchr(p, '\n', end - p);
+		if(!nl)
+		{
+			carry_len = end - p;
+			if(carry_len <= sizeof(carry)) memcpy(carry, p, carry_len);
+			else carry_len = sizeof(carry) + 1;
+			return;
+		}
+		parse_line(p, nl);
+		p = nl + 1;
+	}
+}
+
+
+// CRC-16/CCITT-FALSE, as _crc_xmodem_update from 0xffff
+static uint16_t crc_table[256];
+
+static void init_crc_table()
+{
+	for(int i = 0; i < 256; ++i)
+	{
+		uint16_t crc = i << 8;
+		for(int b = 0; b < 8; ++b)
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+		crc_table[i] = crc;
+	}
+}
+
+size_t frame_parser_t::parse(const uint8_t *p, size_t len)
+{
+	if(!crc_table[1]) init_crc_table();
+
+	size_t i = 0;
+	for(;;)
+	{
+		const uint8_t *sync = (const uint8_t *)memchr(p + i, SERIAL_PROTO_SYNC, len - i);
+		if(!sync) return len;
+		i = sync - p;
+		if(len - i < 2) return i;
+		if(p[i + 1] != STATUS_FRAME_LEN)
+		{
+			++i;
+			continue;
+		}
+		if(len - i < STATUS_FRAME_SIZE) return i;
+
+		const uint8_t *f = p + i + 1;
+		uint16_t crc = 0xffff;
+		for(size_t k = 0; k < 1 + STATUS_FRAME_LEN; ++k)
+			crc = (crc << 8) ^ crc_table[(crc >> 8) ^ f[k]];
+		uint16_t got = f[1 + STATUS_FRAME_LEN] | (f[2 + STATUS_FRAME_LEN] << 8);
+		if(crc != got || f[1] != (CMD_GET_STATUS | CMD_REPLY) || f[2] != STATUS_OK)
+		{
+			++i;
+			continue;
+		}
+
+		status_reply_t st;
+		memcpy(&st, f + 3, sizeof(st)); // little endian host assumed
+		telemetry_sample_t s;
+		s.t = frames * interval;
+		s.heater_temp = st.heater_temp;
+		s.air_temp = st.air_temp;
+		s.env_temp = st.env_temp;
+		s.heater_set_point = st.heater_set_point;
+		s.air_set_point = st.air_set_point;
+		s.heater_power = st.heater_power;
+		++frames;
+		sink(s, ctx);
+		i += STATUS_FRAME_SIZE;
+	}
+}
+
+void frame_parser_t::feed(const uint8_t *buf, size_t len)
+{
+	size_t off = 0;
+	if(carry_len)
+	{
+		// finish the frame which started in the previous chunk
+		uint8_t joined[sizeof(carry) + STATUS_FRAME_SIZE];
+		size_t extra = len < STATUS_FRAME_SIZE ? len : STATUS_FRAME_SIZE;
+		memcpy(joined, carry, carry_len);
+		memcpy(joined + carry_len, buf, extra);
+		size_t pos = parse(joined, carry_len + extra);
+		if(pos < carry_len)
+		{
+			// still incomplete; the whole chunk is in joined
+			carry_len = carry_len + extra - pos;
+			memcpy(carry, joined + pos, carry_len);
+			return;
+		}
+		off = pos - carry_len;
+		carry_len = 0;
+		if(off >= len) return;
+	}
+
+	size_t pos = off + parse(buf + off, len - off);
+	carry_len = len - pos;
+	memcpy(carry, buf + pos, carry_len);
+}
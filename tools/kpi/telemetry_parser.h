@@ -0,0 +1,75 @@
+#ifndef TELEMETRY_PARSER_H__
+#define TELEMETRY_PARSER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "serial_proto.h"
+
+#define STATUS_FRAME_LEN (2 + sizeof(status_reply_t)) // LEN of a status reply: CMD, status and data
+#define STATUS_FRAME_SIZE (2 + STATUS_FRAME_LEN + 2) // SYNC, LEN, ..., CRC
+
+/**
+ * one control cycle of telemetry
+ * */
+struct telemetry_sample_t
+{
+	double t; //!< seconds from the start of the stream
+	float heater_temp;
+	float air_temp;
+	float env_temp;
+	float heater_set_point; //!< NAN if the stream does not carry set points
+	float air_set_point;
+	float heater_power; //!< 0 to 256
+};
+
+typedef void (*sample_sink_t)(const telemetry_sample_t &s, void *ctx);
+
+/**
+ * Parser of the text telemetry of manage_temp():
+ *   H0:<t> A:<t> E:<t> P:<target>/<power> T:<heater sp>/<air sp> ...
+ * One line is one oversample block. Other lines are skipped. Input may be
+ * fed in chunks of any size.
+ * */
+class text_parser_t
+{
+	double block_secs;
+	uint64_t blocks; //!< telemetry lines seen
+	char carry[512]; //!< incomplete line from the previous chunk
+	size_t carry_len;
+	sample_sink_t sink;
+	void *ctx;
+
+	void parse_line(const char *p, const char *end);
+
+public:
+	text_parser_t(double block_secs_, sample_sink_t sink_, void *ctx_) :
+		block_secs(block_secs_), blocks(0), carry_len(0), sink(sink_), ctx(ctx_) {}
+
+	void feed(const char *buf, size_t len);
+	uint64_t samples() const { return blocks; }
+};
+
+/**
+ * Parser of CMD_GET_STATUS reply frames of the binary protocol, taken at a
+ * fixed polling interval. Bytes outside valid frames are skipped.
+ * */
+class frame_parser_t
+{
+	double interval;
+	uint64_t frames;
+	uint8_t carry[STATUS_FRAME_SIZE]; //!< incomplete frame from the previous chunk
+	size_t carry_len;
+	sample_sink_t sink;
+	void *ctx;
+
+	size_t parse(const uint8_t *p, size_t len);
+
+public:
+	frame_parser_t(double interval_, sample_sink_t sink_, void *ctx_) :
+		interval(interval_), frames(0), carry_len(0), sink(sink_), ctx(ctx_) {}
+
+	void feed(const uint8_t *buf, size_t len);
+	uint64_t samples() const { return frames; }
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include <math.h>
+#include "cook_sim.h"
+#include "pid.h"
+#include "program.h"
+
+/*
+	Mirrors manage_temp() and prog_runner_t of src/main.cpp; keep the two in
+	sync when the control law changes. Only what affects the air loop is
+	reproduced: programs follow the air set point, so the heater PID output is
+	never used, and the feed-forward table starts empty on a new oven anyway.
+*/
+
+#define BLOCK_SECS 0.256f // one oversample block; the control interval
+#define HEATER_POWER_MAX 256
+#define AIR_TEMP_LPF_COEFF 0.2f
+#define SUPRESS_TEMPERATURE(X) ((X) > 800)
+#define SENSOR_NOISE 0.1f // deg C peak
+
+// deterministic sensor noise, so every run of a configuration is identical
+static float noise(uint32_t &seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return ((int32_t)(seed >> 8) * (1.0f / (1 << 23)) - 1.0f) * SENSOR_NOISE;
+}
+
+static bool is_air_wait(uint8_t op)
+{
+	return op == PROG_WAIT_AIR_TEMP || op == PROG_SET_WAIT_AIR_TEMP;
+}
+
+cook_result_t simulate_cook(const uint16_t *prog, const cook_params_t &params, const oven_model_params_t &model_params,
+	cook_probe_t *probe)
+{
+	oven_model_t oven(model_params);
+	pid_controller_t air_pid(params.air_base_p, params.air_base_i, params.air_base_d, 512, 1, 0.5,
+		params.effective_range, 0, HEATER_POWER_MAX);
+	prog_reader_t reader;
+	reader.open_flash(prog);
+
+	cook_result_t res = {};
+	uint32_t seed = 1;
+	float air_temp = oven.air_sensor;
+	float air_set_point = 0;
+	float heater_power = 0;
+
+	// program runner
+	uint16_t ip = 0;
+	uint8_t op = PROG_END;
+	uint32_t arg = 0;
+	uint8_t len = 0;
+	bool fetch = true;
+	float dwell_end = 0;
+
+	// overshoot tracking per set point
+	float direction = 0; // +1 approaching from below, -1 from above
+	bool reached = false;
+
+	for(float t = 0; t < COOK_MAX_SECS; t += BLOCK_SECS)
+	{
+		// measure
+		float heater_temp = oven.heater + noise(seed);
+		air_temp += (oven.air_sensor + noise(seed) - air_temp) * AIR_TEMP_LPF_COEFF;
+
+		// control
+		air_pid.set_set_point(air_set_point);
+		float target = air_set_point > 0 ? air_pid.update(air_temp) : 0;
+		if(SUPRESS_TEMPERATURE(heater_temp)) target = 0;
+		if(heater_power < target)
+		{
+			heater_power += params.power_increment;
+			if(heater_power > target) heater_power = target;
+			if(heater_power > HEATER_POWER_MAX) heater_power = HEATER_POWER_MAX;
+		}
+		else if(heater_power > target)
+		{
+			heater_power -= params.power_decrement;
+			if(heater_power < target) heater_power = target;
+			if(heater_power < 0) heater_power = 0;
+		}
+
+		float duty = heater_power * (1.0f / HEATER_POWER_MAX);
+		oven.step(duty, BLOCK_SECS);
+		if(probe) probe->block(t, duty, oven);
+		res.energy_wh += duty * model_params.heater_watts * BLOCK_SECS * (1.0f / 3600);
+
+		// metrics against the true air temperature
+		if(air_set_point > 0)
+		{
+			float excess = (oven.air - air_set_point) * direction;
+			if(!reached && excess >= 0) reached = true;
+			if(reached && excess > res.overshoot) res.overshoot = excess;
+			if(!fetch && (op == PROG_DWELL || op == PROG_DWELL_MIN))
+			{
+				res.dwell_secs += BLOCK_SECS;
+				if(fabsf(oven.air - air_set_point) <= COOK_BAND) res.band_secs += BLOCK_SECS;
+			}
+		}
+
+		// run instructions until one has to wait
+		for(;;)
+		{
+			if(fetch)
+			{
+				len = reader.fetch(ip, op, arg);
+				if(op == PROG_END)
+				{
+					res.finished = true;
+					res.cook_secs = t;
+					return res;
+				}
+				fetch = false;
+				if(op == PROG_SET_AIR_TEMP || op == PROG_SET_WAIT_AIR_TEMP)
+				{
+					if(air_set_point != (float)arg)
+					{
+						direction = (float)arg >= oven.air ? 1 : -1;
+						reached = false;
+					}
+					air_set_point = arg;
+				}
+				else if(op == PROG_DWELL)
+					dwell_end = t + arg;
+				else if(op == PROG_DWELL_MIN)
+					dwell_end = t + arg * 60.0f;
+			}
+
+			bool done;
+			if(op == PROG_DWELL || op == PROG_DWELL_MIN)
+				done = t >= dwell_end;
+			else if(is_air_wait(op))
+				done = fabsf(air_temp - (float)arg) <= params.match_margin;
+			else
+				done = true; // heater set points, tones and buttons do not apply
+			if(!done) break;
+			ip += len;
+			fetch = true;
+		}
+	}
+
+	res.cook_secs = COOK_MAX_SECS;
+	return res;
+}
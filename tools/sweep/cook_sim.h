@@ -0,0 +1,51 @@
+#ifndef COOK_SIM_H__
+#define COOK_SIM_H__
+
+#include <stdint.h>
+#include "oven_model.h"
+
+/**
+ * tunables swept by the tool; named after the firmware constants they replace
+ * */
+struct cook_params_t
+{
+	float air_base_p; //!< AIR_BASE_P
+	float air_base_i; //!< AIR_BASE_I
+	float air_base_d; //!< AIR_BASE_D
+	float effective_range; //!< air_pid effective range
+	float power_increment; //!< HEATER_POWER_INCREMENT
+	float power_decrement; //!< HEATER_POWER_DECREMENT
+	float match_margin; //!< TEMP_MATCH_MARGIN
+};
+
+struct cook_result_t
+{
+	bool finished; //!< reached PROG_END within the time limit
+	float cook_secs; //!< time from start to PROG_END
+	float overshoot; //!< largest excursion past a set point after reaching it, deg C
+	float energy_wh; //!< heater energy
+	float band_secs; //!< dwell time with the air within COOK_BAND of its set point
+	float dwell_secs; //!< total dwell time
+};
+
+#define COOK_BAND 2.0f // deg C; time-in-band tolerance
+#define COOK_MAX_SECS (24 * 3600.0f) // give up after this
+
+/**
+ * observer of a simulated cook, called once per block after the plant has
+ * been advanced with the duty applied during that block. It may change the
+ * plant, e.g. to inject faults.
+ * */
+struct cook_probe_t
+{
+	virtual void block(float t, float duty, oven_model_t &oven) = 0;
+};
+
+/**
+ * Run a program image to its end against the oven model, with the firmware
+ * control loop of manage_temp() and the program runner semantics.
+ * */
+cook_result_t simulate_cook(const uint16_t *prog, const cook_params_t &params, const oven_model_params_t &model,
+	cook_probe_t *probe = nullptr);
+
+#endif
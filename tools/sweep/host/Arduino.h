@@ -0,0 +1,40 @@
+#ifndef HOST_ARDUINO_H__
+#define HOST_ARDUINO_H__
+
+// just enough of the Arduino API to build the controller sources on the host
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <avr/pgmspace.h>
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+// output is discarded; the simulation runs thousands of controllers at once
+class host_serial_t
+{
+public:
+	template <typename T> void print(const T &) {}
+	template <typename T> void print(const T &, int) {}
+	template <typename T> void println(const T &) {}
+	int availableForWrite() { return 63; }
+	void write(uint8_t) {}
+	void write(const uint8_t *, size_t) {}
+};
+
+extern host_serial_t Serial;
+
+// avr-libc conversions
+static inline char *ultoa(unsigned long v, char *buf, int)
+{
+	sprintf(buf, "%lu", v);
+	return buf;
+}
+
+// simulated clock; set by the caller
+extern uint32_t host_millis;
+static inline uint32_t millis() { return host_millis; }
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef HOST_AVR_EEPROM_H__
+#define HOST_AVR_EEPROM_H__
+
+// EEPROM in RAM; starts zeroed rather than erased
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <avr/io.h>
+
+extern uint8_t host_eeprom[E2END + 1];
+
+static inline uint8_t eeprom_read_byte(const uint8_t *p) { return host_eeprom[(uintptr_t)p]; }
+static inline uint16_t eeprom_read_word(const uint16_t *p)
+{
+	uint16_t w;
+	memcpy(&w, host_eeprom + (uintptr_t)p, sizeof(w));
+	return w;
+}
+static inline void eeprom_read_block(void *dst, const void *src, size_t n) { memcpy(dst, host_eeprom + (uintptr_t)src, n); }
+static inline void eeprom_update_byte(uint8_t *p, uint8_t v) { host_eeprom[(uintptr_t)p] = v; }
+static inline void eeprom_update_word(uint16_t *p, uint16_t v) { memcpy(host_eeprom + (uintptr_t)p, &v, sizeof(v)); }
+static inline void eeprom_update_block(const void *src, void *dst, size_t n) { memcpy(host_eeprom + (uintptr_t)dst, src, n); }
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef HOST_AVR_IO_H__
+#define HOST_AVR_IO_H__
+
+// ATmega328 memory sizes used by the sources
+
+#define E2END 0x3FF
+
+#endif
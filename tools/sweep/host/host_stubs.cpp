@@ -0,0 +1,15 @@
+#include <Arduino.h>
+#include <stdlib.h>
+#include <avr/eeprom.h>
+#include "prog_store.h"
+
+host_serial_t Serial;
+
+uint8_t host_eeprom[E2END + 1];
+uint32_t host_millis;
+
+// only flash programs are simulated
+void prog_store_read(uint8_t, uint16_t, uint16_t *, uint8_t)
+{
+	abort();
+}
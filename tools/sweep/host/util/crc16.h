@@ -0,0 +1,24 @@
+#ifndef HOST_UTIL_CRC16_H__
+#define HOST_UTIL_CRC16_H__
+
+#include <stdint.h>
+
+// the C equivalents given in the avr-libc documentation
+
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t a)
+{
+	crc ^= a;
+	for(uint8_t i = 0; i < 8; ++i)
+		crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+	return crc;
+}
+
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+	crc ^= (uint16_t)data << 8;
+	for(uint8_t i = 0; i < 8; ++i)
+		crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	return crc;
+}
+
+#endif
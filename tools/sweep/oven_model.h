@@ -0,0 +1,61 @@
+#ifndef OVEN_MODEL_H__
+#define OVEN_MODEL_H__
+
+/*
+	Lumped thermal model of the oven for host simulation.
+
+	Three nodes exchange heat through conductances:
+	  heater element --g_heater_air-- chamber air --g_air_env-- environment
+	                                       |
+	                                  g_air_load
+	                                       |
+	                                 load (potatoes)
+	The air thermistor follows the air with a first-order lag, the heater
+	thermistor reads the element directly. The defaults are rough figures for
+	an 800 W oven with a 1.5 kg load: about 15 minutes from cold to 160 deg C
+	at full power. Fit them against real telemetry before trusting absolute
+	numbers; rankings are much less sensitive to them.
+*/
+
+struct oven_model_params_t
+{
+	float heater_watts = 800; //!< element power at full duty, W
+	float c_heater = 400; //!< element heat capacity, J/K
+	float c_air = 3000; //!< chamber air and walls, J/K
+	float c_load = 5000; //!< load, J/K
+	float g_heater_air = 5; //!< W/K
+	float g_air_env = 2.5; //!< W/K
+	float g_air_load = 4; //!< W/K
+	float air_sensor_tau = 15; //!< s
+	float env = 25; //!< deg C
+};
+
+class oven_model_t
+{
+	const oven_model_params_t &p;
+
+public:
+	float heater; //!< element temperature
+	float air; //!< chamber air temperature
+	float load; //!< load temperature
+	float air_sensor; //!< air thermistor reading
+
+	oven_model_t(const oven_model_params_t &params) : p(params),
+		heater(params.env), air(params.env), load(params.env), air_sensor(params.env) {}
+
+	/**
+	 * advance by dt seconds with the element at duty (0 to 1)
+	 * */
+	void step(float duty, float dt)
+	{
+		float q_ha = p.g_heater_air * (heater - air);
+		float q_al = p.g_air_load * (air - load);
+		float q_ae = p.g_air_env * (air - p.env);
+		heater += (p.heater_watts * duty - q_ha) * dt / p.c_heater;
+		air += (q_ha - q_al - q_ae) * dt / p.c_air;
+		load += q_al * dt / p.c_load;
+		air_sensor += (air - air_sensor) * dt / p.air_sensor_tau;
+	}
+};
+
+#endif
@@ -0,0 +1,156 @@
+/*
+	Parallel parameter sweep of the air control loop on the host.
+
+	Every combination of the values in the grid below is cooked through PROG1
+	and PROG2 against the oven model, spread over all cores. Configurations
+	are scored by total cook time, worst overshoot, energy and time-in-band
+	during dwells; the Pareto front of the four is printed as CSV, sorted by
+	cook time. Column names are the firmware constants, so a row can be pasted
+	back into src/main.cpp.
+
+	  make && ./sweep [-j threads] > front.csv
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "builtin_programs.h"
+#include "cook_sim.h"
+
+// sweep grid; the firmware defaults are included in every axis
+static const float GRID_P[] = {15, 30, 45, 60};
+static const float GRID_I[] = {0.5, 1, 2};
+static const float GRID_D[] = {300, 600, 1200};
+static const float GRID_RANGE[] = {20, 40, 60};
+static const float GRID_INCREMENT[] = {45, 90, 180};
+static const float GRID_DECREMENT[] = {35, 70, 140};
+static const float GRID_MARGIN[] = {1.0, 1.5, 2.5};
+
+#define COUNT(A) (sizeof(A) / sizeof(A[0]))
+
+static const uint16_t * const PROGRAMS[] = { PROG1.words, PROG2.words };
+
+struct score_t
+{
+	cook_params_t params;
+	bool finished;
+	float cook_secs; //!< sum over the programs
+	float overshoot; //!< worst over the programs
+	float energy_wh; //!< sum over the programs
+	float in_band; //!< fraction of all dwell time within COOK_BAND
+};
+
+// decompose a configuration index into grid values
+static cook_params_t grid_params(size_t n)
+{
+	cook_params_t p;
+	p.air_base_p = GRID_P[n % COUNT(GRID_P)]; n /= COUNT(GRID_P);
+	p.air_base_i = GRID_I[n % COUNT(GRID_I)]; n /= COUNT(GRID_I);
+	p.air_base_d = GRID_D[n % COUNT(GRID_D)]; n /= COUNT(GRID_D);
+	p.effective_range = GRID_RANGE[n % COUNT(GRID_RANGE)]; n /= COUNT(GRID_RANGE);
+	p.power_increment = GRID_INCREMENT[n % COUNT(GRID_INCREMENT)]; n /= COUNT(GRID_INCREMENT);
+	p.power_decrement = GRID_DECREMENT[n % COUNT(GRID_DECREMENT)]; n /= COUNT(GRID_DECREMENT);
+	p.match_margin = GRID_MARGIN[n % COUNT(GRID_MARGIN)];
+	return p;
+}
+
+static score_t evaluate(const cook_params_t &params, const oven_model_params_t &model)
+{
+	score_t s = {};
+	s.params = params;
+	s.finished = true;
+	float band = 0, dwell = 0;
+	for(const uint16_t *prog : PROGRAMS)
+	{
+		cook_result_t r = simulate_cook(prog, params, model);
+		s.finished = s.finished && r.finished;
+		s.cook_secs += r.cook_secs;
+		s.overshoot = std::max(s.overshoot, r.overshoot);
+		s.energy_wh += r.energy_wh;
+		band += r.band_secs;
+		dwell += r.dwell_secs;
+	}
+	s.in_band = dwell > 0 ? band / dwell : 0;
+	return s;
+}
+
+// a is at least as good as b in every objective and better in one
+static bool dominates(const score_t &a, const score_t &b)
+{
+	bool le = a.cook_secs <= b.cook_secs && a.overshoot <= b.overshoot &&
+		a.energy_wh <= b.energy_wh && a.in_band >= b.in_band;
+	bool lt = a.cook_secs < b.cook_secs || a.overshoot < b.overshoot ||
+		a.energy_wh < b.energy_wh || a.in_band > b.in_band;
+	return le && lt;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned threads = std::thread::hardware_concurrency();
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], "-j") && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [-j threads]\n", argv[0]);
+			return 2;
+		}
+	}
+	if(threads == 0) threads = 1;
+
+	const size_t total = COUNT(GRID_P) * COUNT(GRID_I) * COUNT(GRID_D) * COUNT(GRID_RANGE) *
+		COUNT(GRID_INCREMENT) * COUNT(GRID_DECREMENT) * COUNT(GRID_MARGIN);
+	const oven_model_params_t model;
+	std::vector<score_t> scores(total);
+	std::atomic<size_t> next(0);
+
+	fprintf(stderr, "%zu configurations, %zu cooks, %u threads\n", total, total * COUNT(PROGRAMS), threads);
+	std::vector<std::thread> pool;
+	for(unsigned t = 0; t < threads; ++t)
+	{
+		pool.emplace_back([&]()
+		{
+			for(size_t n; (n = next++) < total; )
+				scores[n] = evaluate(grid_params(n), model);
+		});
+	}
+	for(auto &&t : pool) t.join();
+
+	// Pareto front of the configurations which finished both programs
+	std::vector<score_t> front;
+	for(const score_t &s : scores)
+	{
+		if(!s.finished) continue;
+		bool dominated = false;
+		for(const score_t &o : scores)
+		{
+			if(o.finished && dominates(o, s))
+			{
+				dominated = true;
+				break;
+			}
+		}
+		if(!dominated) front.push_back(s);
+	}
+	std::sort(front.begin(), front.end(),
+		[](const score_t &a, const score_t &b) { return a.cook_secs < b.cook_secs; });
+
+	printf("cook_min,overshoot_c,energy_wh,in_band,"
+		"AIR_BASE_P,AIR_BASE_I,AIR_BASE_D,air_effective_range,"
+		"HEATER_POWER_INCREMENT,HEATER_POWER_DECREMENT,TEMP_MATCH_MARGIN\n");
+	for(const score_t &s : front)
+	{
+		const cook_params_t &p = s.params;
+		printf("%.1f,%.2f,%.0f,%.3f,%g,%g,%g,%g,%g,%g,%g\n",
+			s.cook_secs / 60, s.overshoot, s.energy_wh, s.in_band,
+			p.air_base_p, p.air_base_i, p.air_base_d, p.effective_range,
+			p.power_increment, p.power_decrement, p.match_margin);
+	}
+	fprintf(stderr, "%zu configurations on the Pareto front\n", front.size());
+	return 0;
+}